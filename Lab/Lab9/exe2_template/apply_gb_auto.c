@@ -0,0 +1,234 @@
+/**
+ * Autotuned apply_gb.
+ * Images are grouped into shape classes: pixel count rounded down to a power
+ * of two, channel count, kernel length and min_length. The first time a class
+ * is seen, every exact backend in gb_backends, the direct two-pass base
+ * included, is timed on a probe cut from the image and the fastest is
+ * appended to the tuning file (GB_TUNE_FILE, default gb_tune.txt; an empty GB_TUNE_FILE keeps
+ * the choices in memory only). Later calls, in this process or the next,
+ * dispatch straight to the recorded backend.
+ */
+#include "main.h"
+#include <string.h>
+
+#define GB_TUNE_DEFAULT "gb_tune.txt"
+#define MAX_TUNED 256
+#define PROBE_DIM 256
+#define PROBE_RUNS 2
+/* a probe run this long (seconds) is not noisy enough to repeat */
+#define PROBE_LONG 0.05
+
+typedef struct Tuned
+{
+    unsigned int size_class, channels, length, min_length;
+    char name[32];
+} Tuned;
+
+static Tuned tuned[MAX_TUNED];
+static int num_tuned = -1;
+
+static const char* tune_path(void)
+{
+    const char* p = getenv("GB_TUNE_FILE");
+    return p ? p : GB_TUNE_DEFAULT;
+}
+
+/* tuning file: one "size_class channels length min_length backend" line per class */
+static void load_tuning(void)
+{
+    FILE* f = *tune_path() ? fopen(tune_path(), "r") : NULL;
+    num_tuned = 0;
+    if (!f)
+    {
+        return;
+    }
+    while (num_tuned < MAX_TUNED)
+    {
+        Tuned* t = &tuned[num_tuned];
+        if (fscanf(f, "%u %u %u %u %31s", &t->size_class, &t->channels, &t->length, &t->min_length, t->name) != 5)
+        {
+            break;
+        }
+        num_tuned++;
+    }
+    fclose(f);
+}
+
+static unsigned int size_class(Image a)
+{
+    unsigned long n = (unsigned long)a.dimX * a.dimY;
+    unsigned int c = 0;
+    while (n > 1)
+    {
+        n >>= 1;
+        c++;
+    }
+    return c;
+}
+
+static const Backend* find_backend(const char* name)
+{
+    for (unsigned int i = 0; i < gb_num_backends; i++)
+    {
+        if (strcmp(gb_backends[i].name, name) == 0)
+        {
+            return &gb_backends[i];
+        }
+    }
+    return NULL;
+}
+
+static int candidate(const Backend* b, Image a)
+{
+    if (!(b->flags & GB_EXACT) || (b->flags & GB_AUTO))
+    {
+        return 0;
+    }
+    return !(b->flags & GB_MONO) || a.numChannels == 1;
+}
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/* probe extent along one axis of dim pixels */
+static unsigned int probe_dim(unsigned int dim, unsigned int edge)
+{
+    unsigned int cap = dim / 2 > PROBE_DIM ? dim / 2 : PROBE_DIM;
+    if (edge > cap)
+    {
+        edge = cap;
+    }
+    return dim < edge ? dim : edge;
+}
+
+/*
+ * Times the candidates on the top-left corner of a. The probe keeps the
+ * kernel's border band (2 * max(min_deta, ext - min_deta)) plus PROBE_DIM
+ * interior pixels per axis, so border and interior costs both show up, but
+ * never more than half the image per axis: a long kernel on a small image
+ * would otherwise make the probe the whole image, and tuning several times
+ * the job.
+ */
+static const Backend* tune(Image a, FVec gv)
+{
+    int ext = gv.length / 2, md = gv.min_deta;
+    unsigned int edge = 2 * (md > ext - md ? md : ext - md) + PROBE_DIM;
+    Image probe = a, work = a;
+    probe.dimX = probe_dim(a.dimX, edge);
+    probe.dimY = probe_dim(a.dimY, edge);
+    size_t row = (size_t)probe.dimX * a.numChannels, n = row * probe.dimY;
+    const Backend* best = NULL;
+    double best_t = 0;
+
+    probe.data = img_alloc(n * sizeof(float));
+    work = probe;
+    work.data = img_alloc(n * sizeof(float));
+    for (unsigned int y = 0; y < probe.dimY; y++)
+    {
+        memcpy(probe.data + y * row, a.data + (size_t)y * a.dimX * a.numChannels, row * sizeof(float));
+    }
+
+    for (unsigned int i = 0; i < gb_num_backends; i++)
+    {
+        const Backend* b = &gb_backends[i];
+        double t = 0;
+        if (!candidate(b, a))
+        {
+            continue;
+        }
+        for (int r = 0; r < PROBE_RUNS; r++)
+        {
+            memcpy(work.data, probe.data, n * sizeof(float));
+            int saved = stdout_mute();
+            double start = now();
+            Image out = b->fn(work, gv);
+            double elapsed = now() - start;
+            stdout_restore(saved);
+            if (out.data != work.data)
+            {
+                img_free(out.data);
+            }
+            if (r == 0 || elapsed < t)
+            {
+                t = elapsed;
+            }
+            if (elapsed > PROBE_LONG)
+            {
+                break;
+            }
+        }
+        printf("autotune %ux%u: %s %f\n", probe.dimX, probe.dimY, b->name, t);
+        if (!best || t < best_t)
+        {
+            best = b;
+            best_t = t;
+        }
+    }
+
+    img_free(probe.data);
+    img_free(work.data);
+    return best;
+}
+
+Image apply_gb(Image a, FVec gv)
+{
+    const Backend* b = NULL;
+    unsigned int cls = size_class(a);
+    int i;
+
+    if (num_tuned < 0)
+    {
+        load_tuning();
+    }
+    for (i = 0; i < num_tuned; i++)
+    {
+        Tuned* t = &tuned[i];
+        if (t->size_class == cls && t->channels == a.numChannels && t->length == gv.length && t->min_length == gv.min_length)
+        {
+            b = find_backend(t->name);
+            break;
+        }
+    }
+
+    /* unknown class, or the file names a backend this build does not have */
+    if (!b || !candidate(b, a))
+    {
+        b = tune(a, gv);
+        if (i == num_tuned && num_tuned < MAX_TUNED)
+        {
+            num_tuned++;
+        }
+        if (i < MAX_TUNED)
+        {
+            Tuned* t = &tuned[i];
+            t->size_class = cls;
+            t->channels = a.numChannels;
+            t->length = gv.length;
+            t->min_length = gv.min_length;
+            snprintf(t->name, sizeof(t->name), "%s", b->name);
+        }
+        FILE* f = *tune_path() ? fopen(tune_path(), "w") : NULL;
+        if (f)
+        {
+            for (int j = 0; j < num_tuned; j++)
+            {
+                fprintf(f, "%u %u %u %u %s\n", tuned[j].size_class, tuned[j].channels, tuned[j].length, tuned[j].min_length, tuned[j].name);
+            }
+            fclose(f);
+        }
+    }
+
+    printf("autotune: %s\n", b->name);
+    /* keep the caller's image intact even when the winner works in place */
+    if (b->flags & GB_INPLACE)
+    {
+        Image c = img_sc(a);
+        memcpy(c.data, a.data, (size_t)a.dimX * a.dimY * a.numChannels * sizeof(float));
+        return b->fn(c, gv);
+    }
+    return b->fn(a, gv);
+}
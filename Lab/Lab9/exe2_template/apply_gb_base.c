@@ -23,6 +23,6 @@ Image apply_gb(Image a, FVec gv)
     timersub(&stop_time, &start_time, &elapsed_time); 
     printf("vertical gaussian blur time: %f \n", elapsed_time.tv_sec+elapsed_time.tv_usec/1000000.0);
 
-    free(b.data);
+    img_free(b.data);
     return c;
 }
@@ -22,7 +22,7 @@ Image apply_gb(Image a, FVec gv) {
     b = transpose(b);
     Image c = gb_h(b, gv);
     c = transpose(c);
-    free(b.data);
+    img_free(b.data);
     return c;
 }
 /**********You need to modify the code above this section***********/
\ No newline at end of file
@@ -0,0 +1,199 @@
+/**
+ * In-place Gaussian blur: the result overwrites the input image.
+ * The only allocations are per-thread scratch: a border-padded copy of one
+ * row for the horizontal pass, and a ring of the last length/2+1 original
+ * rows of one column block for the vertical pass. That is O(width * kernel)
+ * in total, instead of the two whole-image copies made by gb_h/gb_v.
+ * Every pixel sums its taps in the same order as gb_h/gb_v, so the output is
+ * identical to apply_gb_base.c.
+ */
+#include "main.h"
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* scratch bytes held by all threads at once during the last apply_gb */
+static size_t scratch_peak;
+
+size_t gb_inplace_scratch(void)
+{
+    return scratch_peak;
+}
+
+/* same window shrink as gb_h/gb_v: distance to the nearest border, capped at min_deta */
+static inline int gb_deta(Image a, FVec gv, int x, int y)
+{
+    int d = x;
+    if (y < d) d = y;
+    if ((int)a.dimX - 1 - x < d) d = a.dimX - 1 - x;
+    if ((int)a.dimY - 1 - y < d) d = a.dimY - 1 - y;
+    return d < (int)gv.min_deta ? d : (int)gv.min_deta;
+}
+
+/* shrink shared by every pixel of row y that is far enough from the left/right border */
+static inline int row_deta(Image a, FVec gv, int y)
+{
+    int d = y;
+    if ((int)a.dimY - 1 - y < d) d = a.dimY - 1 - y;
+    return d < (int)gv.min_deta ? d : (int)gv.min_deta;
+}
+
+/* pad holds (dimX + 2 * ext) pixels: the row with its edge pixels repeated ext times on each side */
+static void row_h(float *row, float *pad, Image a, FVec gv, int y)
+{
+    int W = a.dimX, C = a.numChannels, ext = gv.length / 2;
+    int dy = row_deta(a, gv, y);
+    int lo = dy, hi = W - dy;
+    int x, c, i, k;
+
+    for (x = 0; x < ext; x++)
+    {
+        memcpy(pad + x * C, row, C * sizeof(float));
+        memcpy(pad + (ext + W + x) * C, row + (W - 1) * C, C * sizeof(float));
+    }
+    memcpy(pad + ext * C, row, (size_t)W * C * sizeof(float));
+
+    /* pixels in [lo, hi) all use the window shrunk by dy: sweep tap by tap */
+    if (hi > lo)
+    {
+        memset(row + lo * C, 0, (size_t)(hi - lo) * C * sizeof(float));
+        for (i = dy; i < (int)gv.length - dy; i++)
+        {
+            float w = gv.data[i] / gv.sum[ext - dy];
+            const float *s = pad + i * C;
+            for (k = lo * C; k < hi * C; k++)
+            {
+                row[k] += w * s[k];
+            }
+        }
+    }
+    else
+    {
+        lo = hi = W;
+    }
+
+    for (x = 0; x < W; x++)
+    {
+        if (x == lo)
+        {
+            x = hi;
+            if (x >= W) break;
+        }
+        int d = gb_deta(a, gv, x, y);
+        for (c = 0; c < C; c++)
+        {
+            float sum = 0;
+            for (i = d; i < (int)gv.length - d; i++)
+            {
+                sum += gv.data[i] / gv.sum[ext - d] * pad[(x + i) * C + c];
+            }
+            row[x * C + c] = sum;
+        }
+    }
+}
+
+/*
+ * Vertical pass over columns [x0, x1). Before row y is overwritten its
+ * original values go to ring slot y % rows; taps above y read the ring,
+ * taps below y read the image, which is still unmodified there.
+ */
+static void block_v(Image a, FVec gv, float *ring, int rows, int x0, int x1)
+{
+    int W = a.dimX, H = a.dimY, C = a.numChannels, ext = gv.length / 2;
+    size_t stride = (size_t)W * C, bw = (size_t)(x1 - x0) * C;
+    int x, y, c, i, k, r;
+
+    for (y = 0; y < H; y++)
+    {
+        float *row = a.data + y * stride + x0 * C;
+        int dy = row_deta(a, gv, y);
+        int lo = dy > x0 ? dy : x0, hi = W - dy < x1 ? W - dy : x1;
+
+        memcpy(ring + (y % rows) * bw, row, bw * sizeof(float));
+
+        if (hi > lo)
+        {
+            memset(row + (lo - x0) * C, 0, (size_t)(hi - lo) * C * sizeof(float));
+            for (i = dy; i < (int)gv.length - dy; i++)
+            {
+                float w = gv.data[i] / gv.sum[ext - dy];
+                r = y + i - ext;
+                r = r < 0 ? 0 : (r > H - 1 ? H - 1 : r);
+                const float *s = r <= y ? ring + (r % rows) * bw : a.data + r * stride + x0 * C;
+                for (k = (lo - x0) * C; k < (hi - x0) * C; k++)
+                {
+                    row[k] += w * s[k];
+                }
+            }
+        }
+        else
+        {
+            lo = hi = x1;
+        }
+
+        for (x = x0; x < x1; x++)
+        {
+            if (x == lo)
+            {
+                x = hi;
+                if (x >= x1) break;
+            }
+            int d = gb_deta(a, gv, x, y);
+            for (c = 0; c < C; c++)
+            {
+                float sum = 0;
+                for (i = d; i < (int)gv.length - d; i++)
+                {
+                    r = y + i - ext;
+                    r = r < 0 ? 0 : (r > H - 1 ? H - 1 : r);
+                    const float *s = r <= y ? ring + (r % rows) * bw : a.data + r * stride + x0 * C;
+                    sum += gv.data[i] / gv.sum[ext - d] * s[(x - x0) * C + c];
+                }
+                row[(x - x0) * C + c] = sum;
+            }
+        }
+    }
+}
+
+Image apply_gb(Image a, FVec gv)
+{
+    int W = a.dimX, H = a.dimY, C = a.numChannels, ext = gv.length / 2;
+    int threads = 1;
+    int rows = ext + 1 < H ? ext + 1 : H;
+    int y;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    int bw = (W + threads - 1) / threads;
+    int blocks = (W + bw - 1) / bw;
+    size_t pad_bytes = (size_t)(W + 2 * ext) * C * sizeof(float);
+    size_t ring_bytes = (size_t)rows * bw * C * sizeof(float);
+
+#pragma omp parallel
+    {
+        float *pad = malloc(pad_bytes);
+#pragma omp for schedule(dynamic, 4)
+        for (y = 0; y < H; y++)
+        {
+            row_h(a.data + (size_t)y * W * C, pad, a, gv, y);
+        }
+        free(pad);
+    }
+
+#pragma omp parallel
+    {
+        float *ring = malloc(ring_bytes);
+        int blk;
+#pragma omp for schedule(dynamic, 1)
+        for (blk = 0; blk < blocks; blk++)
+        {
+            int x1 = (blk + 1) * bw;
+            block_v(a, gv, ring, rows, blk * bw, x1 < W ? x1 : W);
+        }
+        free(ring);
+    }
+
+    scratch_peak = threads * (pad_bytes > ring_bytes ? pad_bytes : ring_bytes);
+    return a;
+}
@@ -0,0 +1,24 @@
+/**
+ * The apply_gb backends that gb_bench and gbfloat_auto link side by side.
+ * Each backend file is compiled once per entry with -Dapply_gb=<function>
+ * (the backends target in the Makefile).
+ */
+#include "main.h"
+
+Image apply_gb_base(Image a, FVec gv);
+Image apply_gb_fast(Image a, FVec gv);
+Image apply_gb_simd(Image a, FVec gv);
+Image apply_gb_f16(Image a, FVec gv);
+Image apply_gb_inplace(Image a, FVec gv);
+Image apply_gb_auto(Image a, FVec gv);
+
+const Backend gb_backends[] = {
+    {"base",    apply_gb_base,    16, GB_EXACT},            /* read a, write b, read b, write c */
+    {"fast",    apply_gb_fast,    32, GB_EXACT | GB_MONO},  /* base plus two transposes */
+    {"simd",    apply_gb_simd,    16, GB_EXACT},
+    {"f16",     apply_gb_f16,     12, 0},                   /* fp16 intermediate: 4 + 2 + 2 + 4 */
+    {"inplace", apply_gb_inplace, 16, GB_EXACT | GB_INPLACE},
+    {"auto",    apply_gb_auto,    16, GB_EXACT | GB_AUTO},
+};
+
+const unsigned int gb_num_backends = sizeof(gb_backends) / sizeof(gb_backends[0]);
@@ -0,0 +1,342 @@
+/**
+ * Benchmark driver for the apply_gb backends.
+ * Every backend in gb_backends (backends.c) is run over a matrix of image
+ * sizes, channel counts and kernel lengths on synthetic images; backends
+ * flagged GB_MONO skip multi-channel images, where their output is wrong.
+ * Each case gets warmup runs followed by timed runs; the median and p95
+ * times, MPixels/s, nominal bytes moved per pixel, peak memory growth, the
+ * scratch an in-place backend reports (-1 for the others), image pool
+ * allocations and free-list hits, and page faults and dTLB load misses per
+ * timed run are written as CSV and JSON. dTLB misses need perf_event_open
+ * and are reported as -1 where the kernel does not allow it, or where any
+ * run of the case fails to read the counter.
+ *
+ * Usage: ./gb_bench [-s WxH,...] [-c C,...] [-k len/min_len,...] [-w warmup] [-r runs] [-o prefix]
+ */
+#include "main.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define MAX_CASES 16
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/* user-space dTLB load misses of this process, or -1 when perf events are unavailable */
+static int tlb_open(void)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long tlb_read(int fd)
+{
+    long long v;
+    if (fd < 0 || read(fd, &v, sizeof(v)) != sizeof(v))
+    {
+        return -1;
+    }
+    return v;
+}
+
+static int cmp_double(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void release(Image out, Image in)
+{
+    if (out.data != in.data)
+    {
+        img_free(out.data);
+    }
+}
+
+/* a "Vm...:" field of /proc/self/status in KiB, or -1 */
+static long status_kb(const char* key)
+{
+    FILE* f = fopen("/proc/self/status", "r");
+    char line[256];
+    long kb = -1;
+    size_t k = strlen(key);
+    if (!f)
+    {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f))
+    {
+        if (strncmp(line, key, k) == 0)
+        {
+            kb = atol(line + k);
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+/* resets the peak RSS to the current RSS and returns it in KiB, or -1 when the kernel does not allow it */
+static long rss_reset(void)
+{
+    FILE* f = fopen("/proc/self/clear_refs", "w");
+    if (!f)
+    {
+        return -1;
+    }
+    int ok = fputs("5", f) >= 0;
+    ok &= fclose(f) == 0;
+    return ok ? status_kb("VmRSS:") : -1;
+}
+
+/*
+ * Peak memory growth of one run, in KiB, or -1. The run happens in a forked
+ * child. The child first empties the image pool it inherited, since pooled
+ * buffers are already resident and writing them would never raise the peak,
+ * then copies the input, so in-place backends do not count copy-on-write
+ * faults of the parent's pages, and resets its peak RSS before the run.
+ */
+static long peak_kb(const Backend* b, Image src, FVec gv)
+{
+    int fd[2];
+    long kb = -1;
+    if (pipe(fd) != 0)
+    {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        size_t n = (size_t)src.dimX * src.dimY * src.numChannels;
+        Image a = src;
+        img_pool_trim();
+        a.data = img_alloc(n * sizeof(float));
+        memcpy(a.data, src.data, n * sizeof(float));
+        long before = rss_reset();
+        int saved = stdout_mute();
+        Image out = b->fn(a, gv);
+        stdout_restore(saved);
+        long after = status_kb("VmHWM:");
+        kb = before < 0 || after < 0 ? -1 : after - before;
+        if (write(fd[1], &kb, sizeof(kb)) != sizeof(kb))
+        {
+            _exit(1);
+        }
+        release(out, a);
+        _exit(0);
+    }
+    close(fd[1]);
+    if (pid > 0 && read(fd[0], &kb, sizeof(kb)) != sizeof(kb))
+    {
+        kb = -1;
+    }
+    close(fd[0]);
+    if (pid > 0)
+    {
+        waitpid(pid, NULL, 0);
+    }
+    return kb;
+}
+
+static int parse_list(char* s, unsigned int* v, int per, const char* sep)
+{
+    int n = 0;
+    for (char* tok = strtok(s, ","); tok && n < MAX_CASES; tok = strtok(NULL, ","))
+    {
+        if (per == 2)
+        {
+            char* p = strpbrk(tok, sep);
+            if (!p) return -1;
+            v[2 * n] = atoi(tok);
+            v[2 * n + 1] = atoi(p + 1);
+        }
+        else
+        {
+            v[n] = atoi(tok);
+        }
+        n++;
+    }
+    return n;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int sizes[2 * MAX_CASES] = {256, 256, 640, 400, 1024, 1024};
+    unsigned int chans[MAX_CASES] = {1, 3};
+    unsigned int kernels[2 * MAX_CASES] = {101, 21, 1001, 201};
+    int nsizes = 3, nchans = 2, nkernels = 2;
+    int warmup = 1, runs = 5;
+    const char* prefix = "bench";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:c:k:w:r:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': nsizes = parse_list(optarg, sizes, 2, "x"); break;
+        case 'c': nchans = parse_list(optarg, chans, 1, ""); break;
+        case 'k': nkernels = parse_list(optarg, kernels, 2, "/"); break;
+        case 'w': warmup = atoi(optarg); break;
+        case 'r': runs = atoi(optarg); break;
+        case 'o': prefix = optarg; break;
+        default:
+            printf("Usage: %s [-s WxH,...] [-c C,...] [-k len/min_len,...] [-w warmup] [-r runs] [-o prefix]\n", argv[0]);
+            exit(0);
+        }
+    }
+    if (nsizes <= 0 || nchans <= 0 || nkernels <= 0 || runs <= 0)
+    {
+        printf("bad benchmark matrix\n");
+        exit(-1);
+    }
+
+    /* the auto backend tunes in memory and leaves no tuning file behind, unless one is named */
+    setenv("GB_TUNE_FILE", "", 0);
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s.csv", prefix);
+    FILE* csv = fopen(path, "w");
+    snprintf(path, sizeof(path), "%s.json", prefix);
+    FILE* json = fopen(path, "w");
+    if (!csv || !json)
+    {
+        printf("cannot open %s.csv / %s.json\n", prefix, prefix);
+        exit(-1);
+    }
+    fprintf(csv, "backend,width,height,channels,length,min_length,runs,median_s,p95_s,mpix_per_s,bytes_per_px,gb_per_s,peak_kb,scratch_kb,allocs,pool_hits,minflt,majflt,dtlb_miss\n");
+    fprintf(json, "[\n");
+    printf("%-8s %11s %2s %11s %10s %10s %9s %6s %9s %11s %6s %8s %6s %11s\n", "backend", "size", "ch", "kernel", "median_s",
+           "p95_s", "MPix/s", "B/px", "peak_KiB", "scratch_KiB", "pool", "minflt", "majflt", "dTLB_miss");
+    int tlb = tlb_open();
+
+    double* t = malloc(runs * sizeof(double));
+    int first = 1;
+    for (int si = 0; si < nsizes; si++)
+    for (int ci = 0; ci < nchans; ci++)
+    for (int ki = 0; ki < nkernels; ki++)
+    {
+        Image src = {sizes[2 * si], sizes[2 * si + 1], chans[ci], NULL};
+        size_t n = (size_t)src.dimX * src.dimY * src.numChannels;
+        FVec gv = make_gv(0.6, -2.0, 2.0, kernels[2 * ki], kernels[2 * ki + 1]);
+        Image work = src;
+        src.data = img_alloc(n * sizeof(float));
+        work.data = img_alloc(n * sizeof(float));
+        srand(si * 131 + ci * 17 + ki);
+        for (size_t i = 0; i < n; i++)
+        {
+            src.data[i] = rand() / (float)RAND_MAX;
+        }
+
+        for (unsigned int bi = 0; bi < gb_num_backends; bi++)
+        {
+            const Backend* b = &gb_backends[bi];
+            /* a single-channel backend would be timed producing wrong output */
+            if ((b->flags & GB_MONO) && src.numChannels != 1)
+            {
+                continue;
+            }
+            long minflt = 0, majflt = 0;
+            /* -1 once any run's counter cannot be read */
+            long long tlb_miss = tlb >= 0 ? 0 : -1;
+            size_t allocs = 0, pool_hits = 0;
+            for (int r = -warmup; r < runs; r++)
+            {
+                ImgPoolStats p0 = img_pool_stats();
+                struct rusage before, after;
+                /* in-place backends consume their input, so every run starts from a fresh copy */
+                memcpy(work.data, src.data, n * sizeof(float));
+                int saved = stdout_mute();
+                getrusage(RUSAGE_SELF, &before);
+                if (tlb >= 0)
+                {
+                    ioctl(tlb, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(tlb, PERF_EVENT_IOC_ENABLE, 0);
+                }
+                double start = now();
+                Image out = b->fn(work, gv);
+                double elapsed = now() - start;
+                if (tlb >= 0)
+                {
+                    ioctl(tlb, PERF_EVENT_IOC_DISABLE, 0);
+                }
+                getrusage(RUSAGE_SELF, &after);
+                stdout_restore(saved);
+                release(out, work);
+                ImgPoolStats p1 = img_pool_stats();
+                if (r >= 0)
+                {
+                    t[r] = elapsed;
+                    allocs += p1.allocs - p0.allocs;
+                    pool_hits += p1.pool_hits - p0.pool_hits;
+                    minflt += after.ru_minflt - before.ru_minflt;
+                    majflt += after.ru_majflt - before.ru_majflt;
+                    long long miss = tlb_miss >= 0 ? tlb_read(tlb) : -1;
+                    tlb_miss = miss < 0 ? -1 : tlb_miss + miss;
+                }
+            }
+            minflt /= runs;
+            majflt /= runs;
+            allocs /= runs;
+            pool_hits /= runs;
+            tlb_miss = tlb_miss >= 0 ? tlb_miss / runs : -1;
+            qsort(t, runs, sizeof(double), cmp_double);
+            double median = runs % 2 ? t[runs / 2] : (t[runs / 2 - 1] + t[runs / 2]) / 2;
+            double p95 = t[(int)ceil(0.95 * runs) - 1];
+            double mpix = src.dimX * (double)src.dimY / median / 1e6;
+            unsigned int bpp = b->bytes * src.numChannels;
+            long peak = peak_kb(b, src, gv);
+            long scratch = b->flags & GB_INPLACE ? (long)(gb_inplace_scratch() / 1024) : -1;
+
+            fprintf(csv, "%s,%u,%u,%u,%u,%u,%d,%.6f,%.6f,%.3f,%u,%.3f,%ld,%ld,%zu,%zu,%ld,%ld,%lld\n",
+                    b->name, src.dimX, src.dimY, src.numChannels, gv.length, gv.min_length,
+                    runs, median, p95, mpix, bpp, mpix * bpp / 1e3, peak, scratch, allocs, pool_hits, minflt, majflt,
+                    tlb_miss);
+            fprintf(json, "%s  {\"backend\": \"%s\", \"width\": %u, \"height\": %u, \"channels\": %u, "
+                    "\"length\": %u, \"min_length\": %u, \"runs\": %d, \"median_s\": %.6f, \"p95_s\": %.6f, "
+                    "\"mpix_per_s\": %.3f, \"bytes_per_px\": %u, \"gb_per_s\": %.3f, \"peak_kb\": %ld, "
+                    "\"scratch_kb\": %ld, \"allocs\": %zu, \"pool_hits\": %zu, \"minflt\": %ld, \"majflt\": %ld, \"dtlb_miss\": %lld}",
+                    first ? "" : ",\n", b->name, src.dimX, src.dimY, src.numChannels, gv.length, gv.min_length,
+                    runs, median, p95, mpix, bpp, mpix * bpp / 1e3, peak, scratch, allocs, pool_hits, minflt, majflt,
+                    tlb_miss);
+            first = 0;
+            printf("%-8s %5ux%-5u %2u %5u/%-5u %10.6f %10.6f %9.2f %6u %9ld %11ld %3zu/%-2zu %8ld %6ld %11lld\n", b->name,
+                   src.dimX, src.dimY, src.numChannels, gv.length, gv.min_length, median, p95, mpix, bpp, peak, scratch,
+                   pool_hits, allocs, minflt, majflt, tlb_miss);
+            fflush(stdout);
+        }
+
+        img_free(src.data);
+        img_free(work.data);
+        free(gv.data);
+        free(gv.sum);
+    }
+    ImgPoolStats ps = img_pool_stats();
+    printf("image pool: %zu allocs, %zu from free lists, %.1f MiB mapped, %.1f MiB huge pages\n",
+           ps.allocs, ps.pool_hits, ps.os_bytes / 1048576.0, ps.huge_bytes / 1048576.0);
+    if (tlb >= 0)
+    {
+        close(tlb);
+    }
+    fprintf(json, "\n]\n");
+    fclose(csv);
+    fclose(json);
+    free(t);
+    return 0;
+}
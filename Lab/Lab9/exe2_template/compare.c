@@ -0,0 +1,280 @@
+/**
+ * Image comparison for validating approximate blur backends.
+ * Reports max and mean absolute error, PSNR and SSIM over 8x8 tiles, and can
+ * write a heatmap with one pixel per tile (blue = exact, red = the largest
+ * error in the image). Error sums run over the flat float arrays with AVX2 and
+ * tiles are split across OpenMP threads, so large images check in about the
+ * time it takes to read them.
+ *
+ * PSNR and the SSIM constants are taken against peak, the largest sample
+ * value: 255 for the 0..255 floats stbi_loadf gives 8-bit files. Given a
+ * bound on the max abs error and a minimum PSNR, exits with -1 when the test
+ * image misses either, so a Makefile check fails.
+ *
+ * Usage: ./compare <ref> <test> [heatmap.png] [float: peak, default 255] [float: max abs error] [float: min PSNR]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <immintrin.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#define TILE 8
+#define PEAK_LDR 255.0
+#define CHUNK 65536
+
+typedef struct Image
+{
+    unsigned int dimX, dimY, numChannels;
+    float* data;
+} Image;
+
+typedef struct TileStats
+{
+    float sx, sy, sxx, syy, sxy, max_err;
+} TileStats;
+
+static inline float hsum(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+static inline float hmax(__m256 v)
+{
+    __m128 s = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_max_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_max_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+/* full 8x8 tile of channel c: one tile row is one vector (gathered when interleaved) */
+static void tile_simd(const float* a, const float* b, size_t stride, unsigned int C, TileStats* t)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(C));
+    __m256 sx = _mm256_setzero_ps(), sy = sx, sxx = sx, syy = sx, sxy = sx, mx = sx;
+    for (int r = 0; r < TILE; r++)
+    {
+        __m256 x, y;
+        if (C == 1)
+        {
+            x = _mm256_loadu_ps(a + r * stride);
+            y = _mm256_loadu_ps(b + r * stride);
+        }
+        else
+        {
+            x = _mm256_i32gather_ps(a + r * stride, idx, 4);
+            y = _mm256_i32gather_ps(b + r * stride, idx, 4);
+        }
+        sx = _mm256_add_ps(sx, x);
+        sy = _mm256_add_ps(sy, y);
+        sxx = _mm256_add_ps(sxx, _mm256_mul_ps(x, x));
+        syy = _mm256_add_ps(syy, _mm256_mul_ps(y, y));
+        sxy = _mm256_add_ps(sxy, _mm256_mul_ps(x, y));
+        mx = _mm256_max_ps(mx, _mm256_andnot_ps(sign, _mm256_sub_ps(x, y)));
+    }
+    t->sx = hsum(sx);
+    t->sy = hsum(sy);
+    t->sxx = hsum(sxx);
+    t->syy = hsum(syy);
+    t->sxy = hsum(sxy);
+    t->max_err = hmax(mx);
+}
+
+/* partial tiles on the right/bottom edge */
+static void tile_scalar(const float* a, const float* b, size_t stride, unsigned int C, int w, int h, TileStats* t)
+{
+    TileStats s = {0};
+    for (int r = 0; r < h; r++)
+    {
+        for (int i = 0; i < w; i++)
+        {
+            float x = a[r * stride + i * C], y = b[r * stride + i * C];
+            s.sx += x;
+            s.sy += y;
+            s.sxx += x * x;
+            s.syy += y * y;
+            s.sxy += x * y;
+            s.max_err = fmaxf(s.max_err, fabsf(x - y));
+        }
+    }
+    *t = s;
+}
+
+static double ssim(const TileStats* t, int n, double peak)
+{
+    double c1 = (0.01 * peak) * (0.01 * peak), c2 = (0.03 * peak) * (0.03 * peak);
+    double mx = t->sx / n, my = t->sy / n;
+    double vx = t->sxx / n - mx * mx, vy = t->syy / n - my * my, cxy = t->sxy / n - mx * my;
+    return ((2 * mx * my + c1) * (2 * cxy + c2)) / ((mx * mx + my * my + c1) * (vx + vy + c2));
+}
+
+static void heat_color(float v, unsigned char* rgb)
+{
+    float t = v < 0 ? 0 : (v > 1 ? 1 : v);
+    rgb[0] = (unsigned char)(255 * t);
+    rgb[1] = (unsigned char)(255 * (1 - fabsf(2 * t - 1)));
+    rgb[2] = (unsigned char)(255 * (1 - t));
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        printf("Usage: ./compare <ref> <test> [heatmap.png] [float: peak, default 255] [float: max abs error] [float: min PSNR]\n");
+        exit(0);
+    }
+    double peak = PEAK_LDR, err_bound = -1, psnr_bound = -1;
+    if (argc > 4)
+    {
+        sscanf(argv[4], "%lf", &peak);
+    }
+    if (argc > 5)
+    {
+        sscanf(argv[5], "%lf", &err_bound);
+    }
+    if (argc > 6)
+    {
+        sscanf(argv[6], "%lf", &psnr_bound);
+    }
+
+    Image A, B;
+    A.data = stbi_loadf(argv[1], (int*)&A.dimX, (int*)&A.dimY, (int*)&A.numChannels, 0);
+    B.data = stbi_loadf(argv[2], (int*)&B.dimX, (int*)&B.dimY, (int*)&B.numChannels, 0);
+    if (!A.data || !B.data || A.dimX != B.dimX || A.dimY != B.dimY || A.numChannels != B.numChannels)
+    {
+        printf("img size not fit !\n");
+        exit(-1);
+    }
+
+    size_t n = (size_t)A.dimX * A.dimY * A.numChannels;
+    size_t nchunks = (n + CHUNK - 1) / CHUNK;
+    double sum_abs = 0, sum_sq = 0;
+    float max_err = 0;
+    long k;
+
+    /* global error: flat arrays, fp32 differences accumulated in fp64 lanes */
+#pragma omp parallel for schedule(static) reduction(+:sum_abs, sum_sq) reduction(max:max_err)
+    for (k = 0; k < (long)nchunks; k++)
+    {
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        size_t i = k * (size_t)CHUNK, end = i + CHUNK < n ? i + CHUNK : n;
+        __m256d abs_lo = _mm256_setzero_pd(), abs_hi = abs_lo, sq_lo = abs_lo, sq_hi = abs_lo;
+        __m256 mx = _mm256_setzero_ps();
+        for (; i + 8 <= end; i += 8)
+        {
+            __m256 d = _mm256_sub_ps(_mm256_loadu_ps(A.data + i), _mm256_loadu_ps(B.data + i));
+            __m256 ad = _mm256_andnot_ps(sign, d);
+            __m256d dlo = _mm256_cvtps_pd(_mm256_castps256_ps128(d)), dhi = _mm256_cvtps_pd(_mm256_extractf128_ps(d, 1));
+            mx = _mm256_max_ps(mx, ad);
+            abs_lo = _mm256_add_pd(abs_lo, _mm256_cvtps_pd(_mm256_castps256_ps128(ad)));
+            abs_hi = _mm256_add_pd(abs_hi, _mm256_cvtps_pd(_mm256_extractf128_ps(ad, 1)));
+            sq_lo = _mm256_add_pd(sq_lo, _mm256_mul_pd(dlo, dlo));
+            sq_hi = _mm256_add_pd(sq_hi, _mm256_mul_pd(dhi, dhi));
+        }
+        double ab[4], sq[4];
+        _mm256_storeu_pd(ab, _mm256_add_pd(abs_lo, abs_hi));
+        _mm256_storeu_pd(sq, _mm256_add_pd(sq_lo, sq_hi));
+        double s_abs = ab[0] + ab[1] + ab[2] + ab[3], s_sq = sq[0] + sq[1] + sq[2] + sq[3];
+        float m = hmax(mx);
+        for (; i < end; i++)
+        {
+            double d = (double)A.data[i] - B.data[i];
+            s_abs += fabs(d);
+            s_sq += d * d;
+            m = fmaxf(m, fabsf((float)d));
+        }
+        sum_abs += s_abs;
+        sum_sq += s_sq;
+        max_err = fmaxf(max_err, m);
+    }
+
+    /* per-tile SSIM and tile max error for the heatmap */
+    unsigned int tw = (A.dimX + TILE - 1) / TILE, th = (A.dimY + TILE - 1) / TILE;
+    float* tile_err = malloc((size_t)tw * th * sizeof(float));
+    size_t stride = (size_t)A.dimX * A.numChannels;
+    double ssim_sum = 0, ssim_min = DBL_MAX;
+    long ty;
+#pragma omp parallel for schedule(dynamic, 16) reduction(+:ssim_sum) reduction(min:ssim_min)
+    for (ty = 0; ty < (long)th; ty++)
+    {
+        int h = A.dimY - ty * TILE < TILE ? A.dimY - ty * TILE : TILE;
+        for (unsigned int tx = 0; tx < tw; tx++)
+        {
+            int w = A.dimX - tx * TILE < TILE ? A.dimX - tx * TILE : TILE;
+            float err = 0;
+            for (unsigned int c = 0; c < A.numChannels; c++)
+            {
+                size_t off = ty * TILE * stride + (size_t)tx * TILE * A.numChannels + c;
+                TileStats t;
+                if (w == TILE && h == TILE)
+                {
+                    tile_simd(A.data + off, B.data + off, stride, A.numChannels, &t);
+                }
+                else
+                {
+                    tile_scalar(A.data + off, B.data + off, stride, A.numChannels, w, h, &t);
+                }
+                double s = ssim(&t, w * h, peak);
+                ssim_sum += s;
+                ssim_min = s < ssim_min ? s : ssim_min;
+                err = fmaxf(err, t.max_err);
+            }
+            tile_err[ty * tw + tx] = err;
+        }
+    }
+
+    double mse = sum_sq / n;
+    double psnr = mse > 0 ? 10 * log10(peak * peak / mse) : INFINITY;
+    printf("max abs error: %g\n", max_err);
+    printf("mean abs error: %g\n", sum_abs / n);
+    if (mse > 0)
+    {
+        printf("PSNR: %.2f dB\n", psnr);
+    }
+    else
+    {
+        printf("PSNR: inf dB\n");
+    }
+    printf("SSIM (%dx%d tiles): mean %.6f, min %.6f\n", TILE, TILE, ssim_sum / ((double)tw * th * A.numChannels), ssim_min);
+
+    if (argc > 3)
+    {
+        unsigned char* heat = malloc((size_t)tw * th * 3);
+        for (size_t i = 0; i < (size_t)tw * th; i++)
+        {
+            heat_color(max_err > 0 ? tile_err[i] / max_err : 0, heat + 3 * i);
+        }
+        if (!stbi_write_png(argv[3], tw, th, 3, heat, tw * 3))
+        {
+            printf("cannot write %s\n", argv[3]);
+        }
+        free(heat);
+    }
+
+    int ok = 1;
+    if (err_bound >= 0 && max_err > err_bound)
+    {
+        printf("compare failed: max abs error %g above %g\n", max_err, err_bound);
+        ok = 0;
+    }
+    if (psnr_bound >= 0 && psnr < psnr_bound)
+    {
+        printf("compare failed: PSNR %.2f dB below %.2f dB\n", psnr, psnr_bound);
+        ok = 0;
+    }
+
+    free(tile_err);
+    stbi_image_free(A.data);
+    stbi_image_free(B.data);
+    return ok ? 0 : -1;
+}
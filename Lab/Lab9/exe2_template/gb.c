@@ -0,0 +1,225 @@
+/**
+ * Gaussian blur kernels and helpers shared by the command-line program
+ * (main.c), the apply_gb backends and the benchmark (bench.c).
+ */
+
+#include "main.h"
+#include <unistd.h>
+#include <fcntl.h>
+
+void normalize_FVec(FVec v)
+{
+    unsigned int i,j;
+    int ext = v.length / 2;
+    v.sum[0] = v.data[ext];
+    for (i = ext+1,j=1; i < v.length; i++,j++)
+    {
+        v.sum[j] = v.sum[j-1] + v.data[i]*2;
+    }
+
+}
+
+float* get_pixel(Image img, int x, int y)
+{
+    if (x < 0)
+    {
+        x = 0;
+    }
+    if (x >= img.dimX)
+    {
+        x = img.dimX - 1;
+    }
+    if (y < 0)
+    {
+        y = 0;
+    }
+    if (y >= img.dimY)
+    {
+        y = img.dimY - 1;
+    }
+    return img.data + img.numChannels * (y * img.dimX + x);
+}
+
+float gd(float a, float b, float x)
+{
+    float c = (x-b) / a;
+    return exp((-.5) * c * c) / (a * sqrt(2 * PI));
+}
+
+FVec make_gv(float a, float x0, float x1, unsigned int length, unsigned int min_length)
+{
+    FVec v;
+    v.length = length;
+    v.min_length = min_length;
+    if(v.min_length > v.length){
+        v.min_deta = 0;
+    }else{
+        v.min_deta = ((v.length - v.min_length) / 2);
+    }
+    v.data = malloc(length * sizeof(float));
+    v.sum = malloc((length / 2 + 1)* sizeof(float));
+    float step = (x1 - x0) / ((float)length);
+    int offset = length/2;
+
+    for (int i = 0; i < length; i++)
+    {
+        v.data[i] = gd(a, 0.0f, (i-offset)*step);
+    }
+    normalize_FVec(v);
+    return v;
+}
+
+void print_fvec(FVec v)
+{
+    unsigned int i;
+    printf("\n");
+    for (i = 0; i < v.length; i++)
+    {
+        printf("%f ", v.data[i]);
+    }
+    printf("\n");
+}
+
+Image img_sc(Image a)
+{
+    Image b = a;
+    b.data = img_alloc((size_t)b.dimX * b.dimY * b.numChannels * sizeof(float));
+    return b;
+}
+
+Image gb_h(Image a, FVec gv)
+{
+    Image b = img_sc(a);
+
+    int ext = gv.length / 2;
+    int offset;
+    unsigned int x, y, channel;
+    float *pc;
+    float sum;
+    int i;
+    for (channel = 0; channel < a.numChannels; channel++)
+    {
+        for (x = 0; x < a.dimX; x++)
+        {
+            for (y = 0; y < a.dimY; y++)
+            {
+                pc = get_pixel(b, x, y);
+                unsigned int deta = fmin(fmin(a.dimY-y-1, y),fmin(a.dimX-x-1, x));
+                deta = fmin(deta, gv.min_deta);
+                sum = 0;
+                for (i = deta; i < gv.length-deta; i++)
+                {
+                    offset = i - ext;
+                    sum += gv.data[i]/gv.sum[ext - deta] * (float)get_pixel(a, x + offset, y)[channel];
+                }
+                pc[channel] = sum;
+            }
+        }
+    }
+
+    return b;
+}
+
+Image gb_v(Image a, FVec gv)
+{
+    Image b = img_sc(a);
+
+    int ext = gv.length / 2;
+    int offset;
+    unsigned int x, y, channel;
+    float* pc;
+    float sum;
+    int i;
+    for (channel = 0; channel < a.numChannels; channel++)
+    {
+        for (x = 0; x < a.dimX; x++)
+        {
+            for (y = 0; y < a.dimY; y++)
+            {
+                pc = get_pixel(b, x, y);
+                unsigned int deta = fmin(fmin(a.dimY-y-1, y),fmin(a.dimX-x-1, x));
+                deta = fmin(deta, gv.min_deta);
+                sum = 0;
+                for (i = deta; i < gv.length-deta; i++)
+                {
+                    offset = i - ext;
+                    sum += gv.data[i] /gv.sum[ext - deta] * (float)get_pixel(a, x, y + offset)[channel];
+                }
+                pc[channel] = sum;
+            }
+        }
+    }
+    return b;
+}
+
+/**
+ * Vertical pass fused with unsharp masking: instead of storing the blur,
+ * each output pixel is src + amount * (src - blur), clamped to [USM_MIN, USM_MAX].
+ * Pixels whose |src - blur| is below threshold are copied unchanged.
+ * `a` is the horizontally blurred image, `src` the original.
+ */
+Image gb_v_usm(Image src, Image a, FVec gv, float amount, float threshold)
+{
+    Image b = img_sc(a);
+
+    int ext = gv.length / 2;
+    int offset;
+    unsigned int x, y, channel;
+    float* pc;
+    float sum, orig, diff;
+    int i;
+    for (channel = 0; channel < a.numChannels; channel++)
+    {
+        for (x = 0; x < a.dimX; x++)
+        {
+            for (y = 0; y < a.dimY; y++)
+            {
+                pc = get_pixel(b, x, y);
+                unsigned int deta = fmin(fmin(a.dimY-y-1, y),fmin(a.dimX-x-1, x));
+                deta = fmin(deta, gv.min_deta);
+                sum = 0;
+                for (i = deta; i < gv.length-deta; i++)
+                {
+                    offset = i - ext;
+                    sum += gv.data[i] /gv.sum[ext - deta] * (float)get_pixel(a, x, y + offset)[channel];
+                }
+                orig = get_pixel(src, x, y)[channel];
+                diff = orig - sum;
+                if (fabsf(diff) >= threshold)
+                {
+                    orig += amount * diff;
+                    orig = fminf(fmaxf(orig, USM_MIN), USM_MAX);
+                }
+                pc[channel] = orig;
+            }
+        }
+    }
+    return b;
+}
+
+/* Sharpen: one horizontal blur plus the fused vertical pass, no separate blur image */
+Image apply_usm(Image a, FVec gv, float amount, float threshold)
+{
+    Image b = gb_h(a, gv);
+    Image c = gb_v_usm(a, b, gv, amount, threshold);
+    img_free(b.data);
+    return c;
+}
+
+/* the backends print their own timings; callers that time them can silence stdout */
+int stdout_mute(void)
+{
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+    return saved;
+}
+
+void stdout_restore(int saved)
+{
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+}
@@ -0,0 +1,97 @@
+/**
+ * Spatially varying Gaussian blur.
+ * sigma(x, y) = sigma_max * mask(x, y) / GB_VAR_MASK_MAX, mask values in
+ * [0, 255] as stbi_loadf returns them (first channel).
+ * The Gaussian is approximated by a cascade of GB_VAR_BOXES box filters whose
+ * widths are chosen per pixel from its sigma. Each stage builds a summed-area
+ * table (in double, so no precision is lost on large images) of its input,
+ * then every box mean is four table lookups: O(1) per pixel whatever the
+ * local radius. Boxes are clipped to the image and divided by the clipped
+ * area, the same renormalisation gb_h/gb_v use at the borders.
+ */
+#include "main.h"
+#include <string.h>
+
+/* radius of box k in a cascade of odd widths wl, wl + 2 whose variance is sigma^2 */
+static inline int box_radius(float sigma, int k)
+{
+    float s2 = 12.0f * sigma * sigma;
+    int wl = (int)floorf(sqrtf(s2 / GB_VAR_BOXES + 1.0f));
+    if (wl % 2 == 0) wl--;
+    int m = (int)lroundf((s2 - GB_VAR_BOXES * wl * wl - 4 * GB_VAR_BOXES * wl - 3 * GB_VAR_BOXES) / (-4.0f * wl - 4.0f));
+    int w = k < m ? wl : wl + 2;
+    return (w - 1) / 2;
+}
+
+/* sat[(y + 1) * (W + 1) + x + 1] = sum of channel c over [0, x] x [0, y] */
+static void build_sat(double *sat, Image a, unsigned int c)
+{
+    size_t W = a.dimX, H = a.dimY, sw = W + 1;
+    long y;
+
+    memset(sat, 0, sw * sizeof(double));
+#pragma omp parallel for schedule(static)
+    for (y = 0; y < (long)H; y++)
+    {
+        double *row = sat + (y + 1) * sw;
+        const float *src = a.data + y * W * a.numChannels + c;
+        double acc = 0;
+        row[0] = 0;
+        for (size_t x = 0; x < W; x++)
+        {
+            acc += src[x * a.numChannels];
+            row[x + 1] = acc;
+        }
+    }
+    for (y = 1; y < (long)H; y++)
+    {
+        double *row = sat + (y + 1) * sw;
+        const double *prev = row - sw;
+        for (size_t x = 1; x <= W; x++)
+        {
+            row[x] += prev[x];
+        }
+    }
+}
+
+Image gb_var(Image a, Image mask, float sigma_max)
+{
+    size_t W = a.dimX, H = a.dimY, C = a.numChannels, sw = W + 1;
+    double *sat = img_alloc(sw * (H + 1) * sizeof(double));
+    Image cur = a, next = a;
+    long y;
+    int k;
+    unsigned int c;
+
+    cur.data = img_alloc(W * H * C * sizeof(float));
+    next.data = img_alloc(W * H * C * sizeof(float));
+    memcpy(cur.data, a.data, W * H * C * sizeof(float));
+    for (k = 0; k < GB_VAR_BOXES; k++)
+    {
+        for (c = 0; c < C; c++)
+        {
+            build_sat(sat, cur, c);
+#pragma omp parallel for schedule(static)
+            for (y = 0; y < (long)H; y++)
+            {
+                for (long x = 0; x < (long)W; x++)
+                {
+                    float sigma = sigma_max / GB_VAR_MASK_MAX * mask.data[(y * W + x) * mask.numChannels];
+                    long r = box_radius(sigma, k);
+                    long x0 = x - r < 0 ? 0 : x - r, x1 = x + r >= (long)W ? (long)W - 1 : x + r;
+                    long y0 = y - r < 0 ? 0 : y - r, y1 = y + r >= (long)H ? (long)H - 1 : y + r;
+                    double s = sat[(y1 + 1) * sw + x1 + 1] - sat[y0 * sw + x1 + 1]
+                             - sat[(y1 + 1) * sw + x0] + sat[y0 * sw + x0];
+                    next.data[(y * W + x) * C + c] = (float)(s / ((x1 - x0 + 1) * (y1 - y0 + 1)));
+                }
+            }
+        }
+        Image t = cur;
+        cur = next;
+        next = t;
+    }
+
+    img_free(next.data);
+    img_free(sat);
+    return cur;
+}
@@ -0,0 +1,231 @@
+/**
+ * Image buffer allocator.
+ * Every buffer is 64-byte aligned (one cache line, one AVX-512 vector). Sizes
+ * are rounded up to size classes, four per power of two, and freed buffers
+ * are kept on a per-class free list, so the next image of a similar size gets
+ * memory that is already mapped and faulted in. Buffers of IMG_HUGE_MIN bytes
+ * or more are mmap'd on a 2 MiB boundary and madvise'd for transparent huge
+ * pages; with GB_HUGETLB set in the environment explicit hugetlbfs pages are
+ * tried first. GB_POOL_MB caps the bytes kept on the free lists.
+ */
+#include "main.h"
+#include <string.h>
+#include <sys/mman.h>
+
+#define IMG_ALIGN 64
+#define IMG_HUGE_PAGE (2UL << 20)
+#define IMG_HUGE_MIN IMG_HUGE_PAGE
+#define IMG_MIN_CLASS 256UL
+#define IMG_NUM_CLASSES 256
+#define IMG_POOL_MB_DEFAULT 1024
+
+enum { IMG_HEAP, IMG_MMAP, IMG_HUGETLB };
+
+/* sits in the IMG_ALIGN bytes just before the data */
+typedef struct ImgBlock
+{
+    size_t capacity;            /* bytes from the header to the end of the block */
+    struct ImgBlock* next;      /* free list link */
+    int kind;
+    int cls;
+} ImgBlock;
+
+static ImgBlock* pool[IMG_NUM_CLASSES];
+static ImgPoolStats stats;
+static long pool_limit = -1;
+
+/* four classes per power of two, so a buffer wastes at most a quarter of its size */
+static int size_class(size_t bytes, size_t* capacity)
+{
+    size_t c = IMG_MIN_CLASS;
+    int cls = 0;
+    while (c < bytes)
+    {
+        c += ((size_t)1 << (63 - __builtin_clzl(c))) >> 2;
+        cls++;
+    }
+    *capacity = c >= IMG_HUGE_MIN ? (c + IMG_HUGE_PAGE - 1) & ~(IMG_HUGE_PAGE - 1) : c;
+    return cls < IMG_NUM_CLASSES ? cls : -1;
+}
+
+/* *huge is set when the pages are hugetlbfs pages or madvise'd for THP */
+static ImgBlock* map_block(size_t capacity, int* huge)
+{
+    void* p = MAP_FAILED;
+    int kind = IMG_MMAP;
+
+    *huge = 0;
+#ifdef MAP_HUGETLB
+    if (getenv("GB_HUGETLB"))
+    {
+        p = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        kind = IMG_HUGETLB;
+    }
+#endif
+    if (p == MAP_FAILED)
+    {
+        /* over-map by one huge page and trim both ends to a 2 MiB boundary */
+        char* raw = mmap(NULL, capacity + IMG_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+        {
+            return NULL;
+        }
+        char* start = (char*)(((unsigned long)raw + IMG_HUGE_PAGE - 1) & ~(IMG_HUGE_PAGE - 1));
+        if (start > raw)
+        {
+            munmap(raw, start - raw);
+        }
+        munmap(start + capacity, raw + IMG_HUGE_PAGE - start);
+        p = start;
+        kind = IMG_MMAP;
+#ifdef MADV_HUGEPAGE
+        *huge = madvise(p, capacity, MADV_HUGEPAGE) == 0;
+#endif
+    }
+    else
+    {
+        *huge = 1;
+    }
+    ImgBlock* b = p;
+    b->kind = kind;
+    return b;
+}
+
+static void release_block(ImgBlock* b)
+{
+    if (b->kind == IMG_HEAP)
+    {
+        free(b);
+    }
+    else
+    {
+        munmap(b, b->capacity);
+    }
+}
+
+void* img_alloc(size_t bytes)
+{
+    size_t capacity;
+    ImgBlock* b = NULL;
+    int cls = size_class(bytes + IMG_ALIGN, &capacity), huge = 0;
+
+#pragma omp critical(img_pool)
+    {
+        /* img_free reads the limit under the same lock, and only frees what came from here */
+        if (pool_limit < 0)
+        {
+            const char* mb = getenv("GB_POOL_MB");
+            pool_limit = (long)(mb ? atol(mb) : IMG_POOL_MB_DEFAULT) << 20;
+        }
+        stats.allocs++;
+        if (cls >= 0 && pool[cls])
+        {
+            b = pool[cls];
+            pool[cls] = b->next;
+            stats.pool_hits++;
+            stats.cached_bytes -= b->capacity;
+        }
+    }
+
+    if (!b)
+    {
+        if (capacity >= IMG_HUGE_MIN)
+        {
+            b = map_block(capacity, &huge);
+        }
+        else
+        {
+            b = aligned_alloc(IMG_ALIGN, capacity);
+            if (b)
+            {
+                b->kind = IMG_HEAP;
+            }
+        }
+        if (!b)
+        {
+            return NULL;
+        }
+        b->capacity = capacity;
+        b->cls = cls;
+#pragma omp critical(img_pool)
+        {
+            stats.os_bytes += capacity;
+            if (huge)
+            {
+                stats.huge_bytes += capacity;
+            }
+        }
+    }
+    return (char*)b + IMG_ALIGN;
+}
+
+void img_free(void* p)
+{
+    if (!p)
+    {
+        return;
+    }
+    ImgBlock* b = (ImgBlock*)((char*)p - IMG_ALIGN);
+    int keep = 0;
+#pragma omp critical(img_pool)
+    {
+        if (b->cls >= 0 && stats.cached_bytes + b->capacity <= (size_t)pool_limit)
+        {
+            b->next = pool[b->cls];
+            pool[b->cls] = b;
+            stats.cached_bytes += b->capacity;
+            keep = 1;
+        }
+    }
+    if (!keep)
+    {
+        release_block(b);
+    }
+}
+
+void* img_realloc(void* p, size_t bytes)
+{
+    if (!p)
+    {
+        return img_alloc(bytes);
+    }
+    ImgBlock* b = (ImgBlock*)((char*)p - IMG_ALIGN);
+    size_t old = b->capacity - IMG_ALIGN;
+    if (bytes <= old)
+    {
+        return p;
+    }
+    void* q = img_alloc(bytes);
+    if (q)
+    {
+        memcpy(q, p, old);
+        img_free(p);
+    }
+    return q;
+}
+
+/* hands every cached buffer back to the OS */
+void img_pool_trim(void)
+{
+#pragma omp critical(img_pool)
+    {
+        for (int i = 0; i < IMG_NUM_CLASSES; i++)
+        {
+            while (pool[i])
+            {
+                ImgBlock* b = pool[i];
+                pool[i] = b->next;
+                release_block(b);
+            }
+        }
+        stats.cached_bytes = 0;
+    }
+}
+
+ImgPoolStats img_pool_stats(void)
+{
+    ImgPoolStats s;
+#pragma omp critical(img_pool)
+    s = stats;
+    return s;
+}
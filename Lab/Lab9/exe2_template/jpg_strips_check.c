@@ -0,0 +1,136 @@
+/**
+ * Check for the strip-parallel JPEG writer (stb_image_write_strips.h): the
+ * striped output must be byte-identical to a single-threaded encode with the
+ * same restart interval, built here one interval after the other into one
+ * buffer, on 1 and on several threads; it must decode to the same pixels as
+ * the plain stbi_write_jpg encode; and an image too wide for a JPEG frame
+ * header must be refused. Runs the input image as given and a synthetic
+ * 3-channel image with partial MCUs, with and without chroma subsampling.
+ *
+ * Usage: ./jpg_strips_check <inputjpg>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#define STB_IMAGE_WRITE_STRIPS_IMPLEMENTATION
+#include "stb_image_write_strips.h"
+
+static int failed = 0;
+
+static void check(int ok, const char* what)
+{
+    if (!ok)
+    {
+        printf("jpg strips check failed: %s\n", what);
+        failed = 1;
+    }
+}
+
+/* a single-threaded restart-interval encode: header with DRI, then every interval in order */
+static void encode_serial(stbiw__jpg_strip* out, int w, int h, int comp, const float* data, int quality, int strip_rows)
+{
+    stbi__write_context s = { 0 };
+    float fdtbl_Y[64], fdtbl_UV[64];
+    unsigned char YTable[64], UVTable[64];
+    int subsample = stbiw__jpg_setup(quality, fdtbl_Y, fdtbl_UV, YTable, UVTable);
+    int mcu = subsample ? 16 : 8, mcus_per_row = (w + mcu - 1) / mcu, y, i;
+
+    strip_rows = (strip_rows + mcu - 1) / mcu * mcu;
+    stbi__start_write_callbacks(&s, stbiw__jpg_strip_append, out);
+    stbiw__jpg_write_header(&s, w, h, subsample, YTable, UVTable, strip_rows / mcu * mcus_per_row);
+    for (y = 0, i = 0; y < h; y += strip_rows, i++)
+    {
+        if (i > 0)
+        {
+            stbiw__putc(&s, 0xFF);
+            stbiw__putc(&s, (unsigned char)(0xD0 + ((i - 1) & 7)));
+        }
+        stbiw__jpg_write_mcu_rows(&s, w, h, comp, data, subsample, fdtbl_Y, fdtbl_UV, y, y + strip_rows < h ? y + strip_rows : h);
+    }
+    stbiw__putc(&s, 0xFF);
+    stbiw__putc(&s, 0xD9);
+    stbiw__write_flush(&s);
+}
+
+static void check_image(const char* name, int w, int h, int comp, const float* data, int quality, int strip_rows)
+{
+    stbiw__jpg_strip serial = { 0 }, one = { 0 }, many = { 0 }, plain = { 0 };
+    char what[128];
+    int pw, ph, pc, sw, sh, sc;
+
+    encode_serial(&serial, w, h, comp, data, quality, strip_rows);
+    snprintf(what, sizeof(what), "%s: striped encode", name);
+    check(stbi_write_jpg_strips_to_func(stbiw__jpg_strip_append, &one, w, h, comp, data, quality, strip_rows, 1), what);
+    check(stbi_write_jpg_strips_to_func(stbiw__jpg_strip_append, &many, w, h, comp, data, quality, strip_rows, 4), what);
+    check(stbi_write_jpg_to_func(stbiw__jpg_strip_append, &plain, w, h, comp, data, quality), what);
+
+    snprintf(what, sizeof(what), "%s: 1 thread differs from the serial restart-interval encode", name);
+    check(one.len == serial.len && memcmp(one.data, serial.data, serial.len) == 0, what);
+    snprintf(what, sizeof(what), "%s: 4 threads differ from the serial restart-interval encode", name);
+    check(many.len == serial.len && memcmp(many.data, serial.data, serial.len) == 0, what);
+
+    /* restart markers change the entropy coding only, never the decoded pixels */
+    unsigned char* a = stbi_load_from_memory(many.data, (int)many.len, &sw, &sh, &sc, 0);
+    unsigned char* b = stbi_load_from_memory(plain.data, (int)plain.len, &pw, &ph, &pc, 0);
+    snprintf(what, sizeof(what), "%s: striped output decodes differently from stbi_write_jpg", name);
+    check(a && b && sw == pw && sh == ph && sc == pc && memcmp(a, b, (size_t)sw * sh * sc) == 0, what);
+    printf("%s %dx%dx%d q%d, %d-row strips: %zu bytes (plain %zu)\n", name, w, h, comp, quality, strip_rows, many.len, plain.len);
+
+    stbi_image_free(a);
+    stbi_image_free(b);
+    STBIW_FREE(serial.data);
+    STBIW_FREE(one.data);
+    STBIW_FREE(many.data);
+    STBIW_FREE(plain.data);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: ./jpg_strips_check <inputjpg>\n");
+        exit(0);
+    }
+
+    int w, h, c;
+    float* img = stbi_loadf(argv[1], &w, &h, &c, 0);
+    if (!img)
+    {
+        printf("cannot read %s\n", argv[1]);
+        exit(-1);
+    }
+    check_image(argv[1], w, h, c, img, 90, 64);
+    check_image(argv[1], w, h, c, img, 95, 40);
+    stbi_image_free(img);
+
+    /* partial MCUs on both axes */
+    int sw = 203, sh = 157, i;
+    float* syn = malloc((size_t)sw * sh * 3 * sizeof(float));
+    srand(1);
+    for (i = 0; i < sw * sh * 3; i++)
+    {
+        syn[i] = (float)((i / 3 % sw) * 255 / sw + rand() % 32);
+    }
+    check_image("synthetic", sw, sh, 3, syn, 90, 16);
+    check_image("synthetic", sw, sh, 3, syn, 95, 8);
+    check_image("synthetic", sw, sh, 3, syn, 75, 1000);
+    free(syn);
+
+    /* more than 65535 MCUs per row used to make the interval cap 0 and divide by it */
+    stbiw__jpg_strip wide = { 0 };
+    int ww = (1 << 20) + 16;
+    float* row = calloc(ww, sizeof(float));
+    check(!stbi_write_jpg_strips_to_func(stbiw__jpg_strip_append, &wide, ww, 1, 1, row, 90, 64, 0), "image wider than 65535 accepted");
+    check(!stbi_write_jpg_strips_to_func(stbiw__jpg_strip_append, &wide, 70000, 1, 1, row, 90, 64, 0), "image wider than 65535 accepted");
+    free(row);
+    STBIW_FREE(wide.data);
+
+    return failed ? -1 : 0;
+}
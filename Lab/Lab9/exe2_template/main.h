@@ -18,6 +18,15 @@
 
 #define PI 3.14159
 
+/* unsharp mask output is clamped to the 0..255 scale this stbi_loadf returns for LDR input */
+#define USM_MIN 0.0f
+#define USM_MAX 255.0f
+
+/* box filters cascaded per pixel to approximate the Gaussian in gb_var */
+#define GB_VAR_BOXES 3
+/* mask sample that means sigma_max: white on the 0..255 scale of stbi_loadf */
+#define GB_VAR_MASK_MAX 255.0f
+
 typedef struct FVec
 {
     unsigned int length;
@@ -33,9 +42,53 @@ typedef struct Image
     float* data;
 } Image;
 
+FVec make_gv(float a, float x0, float x1, unsigned int length, unsigned int min_length);
+void print_fvec(FVec v);
+float* get_pixel(Image img, int x, int y);
 Image gb_h(Image a, FVec gv);
 Image gb_v(Image a, FVec gv);
 Image img_sc(Image a);
 Image apply_gb(Image a, FVec gv);
+Image gb_v_usm(Image src, Image a, FVec gv, float amount, float threshold);
+Image apply_usm(Image a, FVec gv, float amount, float threshold);
+Image gb_var(Image a, Image mask, float sigma_max);
+/* peak scratch bytes of the last in-place apply_gb (apply_gb_inplace.c) */
+size_t gb_inplace_scratch(void);
+
+/* image buffers: 64-byte aligned, huge pages when large, recycled by size class (img_alloc.c) */
+typedef struct ImgPoolStats
+{
+    size_t allocs, pool_hits;   /* img_alloc calls, and how many the free lists served */
+    size_t os_bytes;            /* bytes requested from the OS */
+    size_t huge_bytes;          /* of those, bytes backed or advised as huge pages */
+    size_t cached_bytes;        /* bytes waiting on the free lists */
+} ImgPoolStats;
+
+void* img_alloc(size_t bytes);
+void* img_realloc(void* p, size_t bytes);
+void img_free(void* p);
+void img_pool_trim(void);
+ImgPoolStats img_pool_stats(void);
+
+int stdout_mute(void);
+void stdout_restore(int saved);
+
+/* Backend flags */
+#define GB_EXACT   1   /* bit-identical to apply_gb_base.c */
+#define GB_INPLACE 2   /* overwrites and returns its input */
+#define GB_MONO    4   /* only correct for single-channel images */
+#define GB_AUTO    8   /* dispatches to the other backends */
+
+/* an apply_gb implementation linked under its own name, see backends.c */
+typedef struct Backend
+{
+    const char* name;
+    Image (*fn)(Image, FVec);
+    unsigned int bytes;     /* compulsory traffic per pixel and channel */
+    unsigned int flags;
+} Backend;
+
+extern const Backend gb_backends[];
+extern const unsigned int gb_num_backends;
 
 #endif
\ No newline at end of file
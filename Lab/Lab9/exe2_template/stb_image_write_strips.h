@@ -0,0 +1,170 @@
+/* stb_image_write_strips.h - strip-parallel JPEG writer on top of stb_image_write.h
+
+   Splits the image into horizontal strips, entropy-codes each strip on its own
+   thread (OpenMP) and stitches them into one baseline JPEG.  A DRI segment sets
+   the restart interval to exactly one strip and RSTn markers separate the
+   strips, so every strip starts with reset DC predictors and a byte-aligned bit
+   buffer.  The output bytes therefore do not depend on the thread count: with
+   num_threads == 1 this is a plain single-threaded restart-interval encode.
+
+   Usage: in the one C file that defines STB_IMAGE_WRITE_IMPLEMENTATION, do
+
+      #include "stb_image_write.h"
+      #define STB_IMAGE_WRITE_STRIPS_IMPLEMENTATION
+      #include "stb_image_write_strips.h"
+
+      int stbi_write_jpg_strips(char const *filename, int w, int h, int comp, const void *data, int quality, int strip_rows, int num_threads);
+
+   strip_rows is rounded up to a whole number of MCU rows (16 pixels when
+   chroma is subsampled, 8 otherwise) and capped so the interval fits the
+   16-bit DRI field.  Images wider or taller than 65535 pixels, which a JPEG
+   frame header cannot describe, are refused (return 0), so one MCU row
+   always fits an interval.  num_threads <= 0 uses the OpenMP default.  The
+   strips are encoded to memory and the file is only opened once they are all
+   done.
+*/
+
+#ifndef INCLUDE_STB_IMAGE_WRITE_STRIPS_H
+#define INCLUDE_STB_IMAGE_WRITE_STRIPS_H
+
+STBIWDEF int stbi_write_jpg_strips_to_func(stbi_write_func *func, void *context, int x, int y, int comp, const void *data, int quality, int strip_rows, int num_threads);
+#ifndef STBI_WRITE_NO_STDIO
+STBIWDEF int stbi_write_jpg_strips(char const *filename, int x, int y, int comp, const void *data, int quality, int strip_rows, int num_threads);
+#endif
+
+#endif // INCLUDE_STB_IMAGE_WRITE_STRIPS_H
+
+#ifdef STB_IMAGE_WRITE_STRIPS_IMPLEMENTATION
+
+#ifndef STB_IMAGE_WRITE_IMPLEMENTATION
+#error "stb_image_write_strips.h needs the stb_image_write.h implementation in the same file"
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+typedef struct
+{
+   unsigned char *data;
+   size_t len, cap;
+   int failed;
+} stbiw__jpg_strip;
+
+static void stbiw__jpg_strip_append(void *context, void *data, int size)
+{
+   stbiw__jpg_strip *b = (stbiw__jpg_strip *) context;
+   if (b->failed) return;
+   if (b->len + size > b->cap) {
+      size_t cap = b->cap ? b->cap * 2 : 4096;
+      unsigned char *p;
+      while (cap < b->len + size) cap *= 2;
+      p = (unsigned char *) STBIW_REALLOC_SIZED(b->data, b->cap, cap);
+      if (!p) { b->failed = 1; return; }
+      b->data = p;
+      b->cap = cap;
+   }
+   STBIW_MEMMOVE(b->data + b->len, data, size);
+   b->len += size;
+}
+
+static int stbiw__jpg_strips_core(stbi__write_context *s, int width, int height, int comp, const void *data, int quality, int strip_rows, int num_threads)
+{
+   int subsample, mcu, mcus_per_row, max_rows, num_strips, i, ok = 1;
+   float fdtbl_Y[64], fdtbl_UV[64];
+   unsigned char YTable[64], UVTable[64];
+   stbiw__jpg_strip *strips;
+
+   if(!data || !width || !height || comp > 4 || comp < 1) {
+      return 0;
+   }
+   // SOF stores 16-bit dimensions; this also keeps mcus_per_row <= 8192, so max_rows >= 7 MCU rows
+   if (width > 65535 || height > 65535) {
+      return 0;
+   }
+
+   subsample = stbiw__jpg_setup(quality, fdtbl_Y, fdtbl_UV, YTable, UVTable);
+   mcu = subsample ? 16 : 8;
+   mcus_per_row = (width + mcu - 1) / mcu;
+
+   strip_rows = strip_rows < mcu ? mcu : (strip_rows + mcu - 1) / mcu * mcu;
+   max_rows = 65535 / mcus_per_row * mcu;
+   if (strip_rows > max_rows) strip_rows = max_rows;
+   num_strips = (height + strip_rows - 1) / strip_rows;
+
+   strips = (stbiw__jpg_strip *) STBIW_MALLOC(num_strips * sizeof(stbiw__jpg_strip));
+   if (!strips) return 0;
+   memset(strips, 0, num_strips * sizeof(stbiw__jpg_strip));
+
+#ifdef _OPENMP
+   if (num_threads <= 0) num_threads = omp_get_max_threads();
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+#endif
+   for (i = 0; i < num_strips; ++i) {
+      stbi__write_context ss = { 0 };
+      int y1 = (i + 1) * strip_rows;
+      stbi__start_write_callbacks(&ss, stbiw__jpg_strip_append, &strips[i]);
+      stbiw__jpg_write_mcu_rows(&ss, width, height, comp, data, subsample, fdtbl_Y, fdtbl_UV, i * strip_rows, y1 < height ? y1 : height);
+      stbiw__write_flush(&ss);
+   }
+   (void) num_threads;
+
+   for (i = 0; i < num_strips; ++i) {
+      if (strips[i].failed) ok = 0;
+   }
+   if (ok) {
+      stbiw__jpg_write_header(s, width, height, subsample, YTable, UVTable, strip_rows / mcu * mcus_per_row);
+      for (i = 0; i < num_strips; ++i) {
+         if (i > 0) {
+            // RST0..RST7 cycle between consecutive intervals
+            stbiw__putc(s, 0xFF);
+            stbiw__putc(s, (unsigned char) (0xD0 + ((i - 1) & 7)));
+         }
+         stbiw__write_flush(s);
+         s->func(s->context, strips[i].data, (int) strips[i].len);
+      }
+      // EOI
+      stbiw__putc(s, 0xFF);
+      stbiw__putc(s, 0xD9);
+   }
+
+   for (i = 0; i < num_strips; ++i) {
+      STBIW_FREE(strips[i].data);
+   }
+   STBIW_FREE(strips);
+   return ok;
+}
+
+STBIWDEF int stbi_write_jpg_strips_to_func(stbi_write_func *func, void *context, int x, int y, int comp, const void *data, int quality, int strip_rows, int num_threads)
+{
+   stbi__write_context s = { 0 };
+   int r;
+   stbi__start_write_callbacks(&s, func, context);
+   r = stbiw__jpg_strips_core(&s, x, y, comp, data, quality, strip_rows, num_threads);
+   stbiw__write_flush(&s);
+   return r;
+}
+
+#ifndef STBI_WRITE_NO_STDIO
+STBIWDEF int stbi_write_jpg_strips(char const *filename, int x, int y, int comp, const void *data, int quality, int strip_rows, int num_threads)
+{
+   stbi__write_context s = { 0 };
+   stbiw__jpg_strip out = { 0 };
+   int r;
+
+   // encode everything to memory first so the file is written in one go
+   stbi__start_write_callbacks(&s, stbiw__jpg_strip_append, &out);
+   r = stbiw__jpg_strips_core(&s, x, y, comp, data, quality, strip_rows, num_threads);
+   stbiw__write_flush(&s);
+   if (r && !out.failed && stbi__start_write_file(&s, filename)) {
+      s.func(s.context, out.data, (int) out.len);
+      stbi__end_write_file(&s);
+   } else {
+      r = 0;
+   }
+   STBIW_FREE(out.data);
+   return r;
+}
+#endif
+
+#endif // STB_IMAGE_WRITE_STRIPS_IMPLEMENTATION
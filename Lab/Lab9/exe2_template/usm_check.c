@@ -0,0 +1,102 @@
+/**
+ * Reference check for the unsharp mask: sharpens the input with apply_usm and
+ * rebuilds every pixel from the plain blur of apply_gb (base) as
+ * src + amount * (src - blur), clamped to the 0..255 scale stbi_loadf gives
+ * an 8-bit file, or src where |src - blur| is below threshold. The two must
+ * agree exactly, since the fused vertical pass sums the taps in the same order
+ * as gb_v. The reference bounds are not USM_MIN/USM_MAX, so a clamp range
+ * that does not match the data fails here.
+ *
+ * Usage: ./usm_check <inputjpg> <float: a> <float: x0> <float: x1> <unsigned int: dim> <unsigned int: min_dim> <float: amount> <float: threshold>
+ */
+
+#include "main.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_MALLOC(sz) img_alloc(sz)
+#define STBI_REALLOC(p, sz) img_realloc(p, sz)
+#define STBI_FREE(p) img_free(p)
+#include "stb_image.h"
+
+/* the range of 8-bit samples as this stbi_loadf returns them */
+#define LDR_MIN 0.0f
+#define LDR_MAX 255.0f
+
+int main(int argc, char** argv)
+{
+    if (argc < 9)
+    {
+        printf("Usage: ./usm_check <inputjpg> <float: a> <float: x0> <float: x1> <unsigned int: dim> <unsigned int: min_dim> <float: amount> <float: threshold>\n");
+        exit(0);
+    }
+
+    float a, x0, x1, amount, threshold;
+    unsigned int dim, min_dim;
+    sscanf(argv[2], "%f", &a);
+    sscanf(argv[3], "%f", &x0);
+    sscanf(argv[4], "%f", &x1);
+    sscanf(argv[5], "%u", &dim);
+    sscanf(argv[6], "%u", &min_dim);
+    sscanf(argv[7], "%f", &amount);
+    sscanf(argv[8], "%f", &threshold);
+
+    FVec v = make_gv(a, x0, x1, dim, min_dim);
+    Image img;
+    img.data = stbi_loadf(argv[1], &(img.dimX), &(img.dimY), &(img.numChannels), 0);
+    if (!img.data)
+    {
+        printf("cannot read %s\n", argv[1]);
+        exit(-1);
+    }
+
+    int saved = stdout_mute();
+    Image blur = apply_gb(img, v);
+    stdout_restore(saved);
+    Image out = apply_usm(img, v, amount, threshold);
+
+    size_t n = (size_t)img.dimX * img.dimY * img.numChannels, i, changed = 0, clamped = 0, wrong = 0;
+    double mean_in = 0, mean_out = 0;
+    float max_err = 0;
+    for (i = 0; i < n; i++)
+    {
+        float src = img.data[i], diff = src - blur.data[i], ref = src;
+        if (fabsf(diff) >= threshold)
+        {
+            ref = src + amount * diff;
+            if (ref < LDR_MIN || ref > LDR_MAX)
+            {
+                clamped++;
+            }
+            ref = fminf(fmaxf(ref, LDR_MIN), LDR_MAX);
+            changed++;
+        }
+        float err = fabsf(out.data[i] - ref);
+        wrong += err > 0;
+        max_err = fmaxf(max_err, err);
+        mean_in += src;
+        mean_out += out.data[i];
+    }
+    mean_in /= n;
+    mean_out /= n;
+    printf("usm: %zu of %zu samples sharpened, %zu clamped, mean %.2f -> %.2f, max error against reference %g\n",
+           changed, n, clamped, mean_in, mean_out, max_err);
+
+    int ok = 1;
+    if (wrong)
+    {
+        printf("usm check failed: %zu samples differ from the reference\n", wrong);
+        ok = 0;
+    }
+    if (changed == 0)
+    {
+        printf("usm check failed: threshold %g leaves every sample unchanged\n", threshold);
+        ok = 0;
+    }
+
+    img_free(out.data);
+    img_free(blur.data);
+    img_free(img.data);
+    free(v.data);
+    free(v.sum);
+    return ok ? 0 : -1;
+}
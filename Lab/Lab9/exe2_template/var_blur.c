@@ -0,0 +1,48 @@
+/**
+ * Depth-of-field style blur: the blur radius of every pixel comes from a
+ * mask image of the same size (black = sharp, white = sigma_max).
+ */
+#include "main.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+/* decoded images come from the image allocator, so they are aligned and recycled like img_sc output */
+#define STBI_MALLOC(sz) img_alloc(sz)
+#define STBI_REALLOC(p, sz) img_realloc(p, sz)
+#define STBI_FREE(p) img_free(p)
+#include "stb_image.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+int main(int argc, char** argv)
+{
+    struct timeval start_time, stop_time, elapsed_time;
+    gettimeofday(&start_time,NULL);
+    if (argc < 5)
+    {
+        printf("Usage: ./gbfloat_var <inputjpg> <maskjpg> <outputname> <float: sigma_max>\n");
+        exit(0);
+    }
+
+    float sigma_max;
+    sscanf(argv[4], "%f", &sigma_max);
+
+    Image img, mask;
+    img.data = stbi_loadf(argv[1], &(img.dimX), &(img.dimY), &(img.numChannels), 0);
+    mask.data = stbi_loadf(argv[2], &(mask.dimX), &(mask.dimY), &(mask.numChannels), 0);
+    if (!img.data || !mask.data || img.dimX != mask.dimX || img.dimY != mask.dimY)
+    {
+        printf("img size not fit !\n");
+        exit(-1);
+    }
+
+    Image imgOut = gb_var(img, mask, sigma_max);
+    stbi_write_jpg(argv[3], imgOut.dimX, imgOut.dimY, imgOut.numChannels, imgOut.data, 90);
+    gettimeofday(&stop_time,NULL);
+    timersub(&stop_time, &start_time, &elapsed_time);
+    printf("%f \n", elapsed_time.tv_sec+elapsed_time.tv_usec/1000000.0);
+    stbi_image_free(img.data);
+    stbi_image_free(mask.data);
+    img_free(imgOut.data);
+    return 0;
+}
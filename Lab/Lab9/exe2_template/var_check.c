@@ -0,0 +1,134 @@
+/**
+ * Check for the spatially varying blur: with a constant mask, gb_var must
+ * reproduce the fixed-sigma blur, a cascade of GB_VAR_BOXES box filters of
+ * one width each, clipped to the image, summed directly here instead of
+ * through summed-area tables. Runs a white mask, which must blur with
+ * sigma_max, and a mask at a fifth of white, which must blur with
+ * sigma_max / 5.
+ *
+ * Usage: ./var_check <inputjpg> <float: sigma_max>
+ */
+
+#include "main.h"
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_MALLOC(sz) img_alloc(sz)
+#define STBI_REALLOC(p, sz) img_realloc(p, sz)
+#define STBI_FREE(p) img_free(p)
+#include "stb_image.h"
+
+/* largest difference allowed against the direct sums, in grey levels */
+#define VAR_TOL 1e-2f
+
+/* radii of the ideal cascade of odd box widths wl, wl + 2 for sigma */
+static void box_radii(float sigma, int* r)
+{
+    double s2 = 12.0 * sigma * sigma;
+    int wl = (int)floor(sqrt(s2 / GB_VAR_BOXES + 1.0));
+    if (wl % 2 == 0) wl--;
+    int m = (int)lround((s2 - GB_VAR_BOXES * wl * wl - 4 * GB_VAR_BOXES * wl - 3 * GB_VAR_BOXES) / (-4.0 * wl - 4.0));
+    for (int k = 0; k < GB_VAR_BOXES; k++)
+    {
+        r[k] = ((k < m ? wl : wl + 2) - 1) / 2;
+    }
+}
+
+/* one box of radius r over every channel, clipped at the borders */
+static void box(const float* src, float* dst, long W, long H, long C, long r)
+{
+    long y;
+#pragma omp parallel for schedule(static)
+    for (y = 0; y < H; y++)
+    {
+        for (long x = 0; x < W; x++)
+        {
+            long x0 = x - r < 0 ? 0 : x - r, x1 = x + r >= W ? W - 1 : x + r;
+            long y0 = y - r < 0 ? 0 : y - r, y1 = y + r >= H ? H - 1 : y + r;
+            for (long c = 0; c < C; c++)
+            {
+                double s = 0;
+                for (long j = y0; j <= y1; j++)
+                    for (long i = x0; i <= x1; i++)
+                        s += src[(j * W + i) * C + c];
+                dst[(y * W + x) * C + c] = (float)(s / ((x1 - x0 + 1) * (y1 - y0 + 1)));
+            }
+        }
+    }
+}
+
+/* gb_var under a mask of constant value level against the fixed cascade for its sigma */
+static int check_level(Image img, float sigma_max, float level)
+{
+    size_t n = (size_t)img.dimX * img.dimY * img.numChannels, i;
+    Image mask = img;
+    mask.numChannels = 1;
+    mask.data = img_alloc((size_t)img.dimX * img.dimY * sizeof(float));
+    for (i = 0; i < (size_t)img.dimX * img.dimY; i++)
+    {
+        mask.data[i] = level;
+    }
+
+    float sigma = sigma_max * level / GB_VAR_MASK_MAX;
+    int r[GB_VAR_BOXES], k;
+    float* cur = img_alloc(n * sizeof(float));
+    float* next = img_alloc(n * sizeof(float));
+    memcpy(cur, img.data, n * sizeof(float));
+    box_radii(sigma, r);
+    for (k = 0; k < GB_VAR_BOXES; k++)
+    {
+        box(cur, next, img.dimX, img.dimY, img.numChannels, r[k]);
+        float* t = cur;
+        cur = next;
+        next = t;
+    }
+
+    Image out = gb_var(img, mask, sigma_max);
+    float max_err = 0;
+    for (i = 0; i < n; i++)
+    {
+        max_err = fmaxf(max_err, fabsf(out.data[i] - cur[i]));
+    }
+    printf("var: mask %g, sigma %g (box radii %d", level, sigma, r[0]);
+    for (k = 1; k < GB_VAR_BOXES; k++)
+    {
+        printf(" %d", r[k]);
+    }
+    printf("), max error against the fixed blur %g\n", max_err);
+
+    img_free(out.data);
+    img_free(cur);
+    img_free(next);
+    img_free(mask.data);
+    if (max_err > VAR_TOL)
+    {
+        printf("var check failed: a constant mask of %g does not give the sigma %g blur\n", level, sigma);
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        printf("Usage: ./var_check <inputjpg> <float: sigma_max>\n");
+        exit(0);
+    }
+
+    float sigma_max;
+    sscanf(argv[2], "%f", &sigma_max);
+    Image img;
+    img.data = stbi_loadf(argv[1], &(img.dimX), &(img.dimY), &(img.numChannels), 0);
+    if (!img.data)
+    {
+        printf("cannot read %s\n", argv[1]);
+        exit(-1);
+    }
+
+    int ok = check_level(img, sigma_max, GB_VAR_MASK_MAX);
+    ok &= check_level(img, sigma_max, GB_VAR_MASK_MAX / 5);
+
+    img_free(img.data);
+    return ok ? 0 : -1;
+}
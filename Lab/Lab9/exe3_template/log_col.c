@@ -0,0 +1,196 @@
+/**
+ * log_base.c on the columnar store: the same table and the same 100 traverse()
+ * passes, plus a check that rebuilt records match what was appended. A second
+ * run leaves 1 row in 100 active to show the bitmap scan skipping the rest,
+ * and log_update_where is checked against a row-by-row reference. A table of
+ * synthetic traffic checks the string dictionaries and reports the footprint
+ * against struct log_entry. Last, the dense traverse is timed from 1 thread up
+ * to all of them.
+ *
+ * Usage: ./log_col [rows for the scaling run]
+ */
+#include "log_store.h"
+
+/* every operator on every column, against log_pred_eval row by row */
+static void check_updates(LogStore* s)
+{
+    size_t i, n = s->rows;
+    int* status = malloc(n * sizeof(int));
+    long* rt = malloc(n * sizeof(long));
+    LogColumn cols[3] = {LOG_COL_STATUS, LOG_COL_SRC_IP, LOG_COL_REFERENCE_TIME};
+    int c, op;
+
+    srand(1);
+    for (i = 0; i < n; i++)
+    {
+        s->src_ip[i] = rand() % 1000 - 500;
+        s->reference_time[i] = rand() % 1000 - 500;
+        log_store_set_status(s, i, rand() % 3);
+    }
+    log_zone_rebuild(s);
+    log_mark_dirty(s, 0, n);
+    for (c = 0; c < 3; c++)
+    for (op = LOG_EQ; op <= LOG_GE; op++)
+    {
+        LogPred p = {cols[c], op, c ? 17 : 1};
+        LogSet sets[2] = {{LOG_COL_REFERENCE_TIME, op * 1000 + c}, {LOG_COL_STATUS, op % 2}};
+        size_t expect = 0;
+        for (i = 0; i < n; i++)
+        {
+            int hit = log_pred_eval(s, p, i);
+            expect += hit;
+            rt[i] = hit ? sets[0].value : s->reference_time[i];
+            status[i] = hit ? sets[1].value : s->status[i];
+        }
+        log_check(log_update_where(s, p, sets, 2) == expect, "update match count");
+        size_t active = 0;
+        for (i = 0; i < n; i++)
+        {
+            log_check(s->reference_time[i] == rt[i] && s->status[i] == status[i], "update result");
+            log_check(((s->active[i / 64] >> (i % 64)) & 1) == (status[i] != 0), "update bitmap");
+            active += status[i] != 0;
+        }
+        log_check(s->active_rows == active, "update active count");
+    }
+    free(status);
+    free(rt);
+}
+
+/* the AoS layout of log_base.c, for footprint comparisons */
+struct log_entry
+{
+    int src_ip;
+    char URL[LOG_STR_LEN];
+    long reference_time;
+    char bro[LOG_STR_LEN];
+    int status;
+};
+
+/* code compares and code histograms agree with strcmp on the decoded rows */
+static void check_dict(void)
+{
+    LogStore s;
+    LogRecord r;
+    size_t i, by_code = 0, by_str = 0;
+    log_store_init(&s, NUM_ENTRIES);
+    log_make_traffic(&s, NUM_ENTRIES, 1);
+
+    const char* url = "/page0.html";
+    uint32_t code = log_dict_find(&s.urls, url);
+    log_check(code != LOG_NO_CODE && log_dict_find(&s.urls, "/missing") == LOG_NO_CODE, "dictionary lookup");
+    log_check(strcmp(log_dict_str(&s.urls, code), url) == 0, "dictionary decode");
+    for (i = 0; i < s.rows; i++)
+    {
+        log_store_get(&s, i, &r);
+        by_str += strcmp(r.URL, url) == 0;
+        by_code += s.URL[i] == code;
+        log_check(log_dict_intern(&s.bros, r.bro) == s.bro[i], "hash-consing");
+    }
+    size_t* counts = malloc(s.urls.count * sizeof(size_t));
+    log_count_codes(&s, LOG_COL_URL, counts);
+    log_check(by_code == by_str && counts[code] == by_str, "code equality");
+    free(counts);
+
+    printf("%zu rows, %u URLs, %u browsers: %zu bytes as struct log_entry, %zu dictionary encoded (%.1fx)\n",
+           s.rows, s.urls.count, s.bros.count, s.rows * sizeof(struct log_entry), log_store_bytes(&s),
+           (double)(s.rows * sizeof(struct log_entry)) / log_store_bytes(&s));
+    log_store_free(&s);
+}
+
+/* 100 dense traverse passes over a fresh table per thread count */
+static void scaling(size_t rows)
+{
+    LogStore s;
+    int t, max = log_max_threads();
+    double base = 0;
+    log_store_init(&s, rows);
+    log_make_logs(&s, rows);
+    for (t = 1; t <= max; t = t < max && t * 2 > max ? max : t * 2)
+    {
+        struct timeval start_time, stop_time, elapsed_time;
+        s.threads = t;
+        gettimeofday(&start_time,NULL);
+        for (int i = 0; i < 100; i++)
+            log_traverse(&s);
+        gettimeofday(&stop_time,NULL);
+        timersub(&stop_time, &start_time, &elapsed_time);
+        double sec = elapsed_time.tv_sec+elapsed_time.tv_usec/1000000.0;
+        if (t == 1)
+            base = sec;
+        printf("%zu rows, %2d threads: %f (%.2fx)\n", rows, t, sec, base / sec);
+    }
+    log_store_free(&s);
+}
+
+int main(int argc, char** argv)
+{
+    LogStore s;
+    LogRecord r;
+    size_t i;
+
+    log_store_init(&s, NUM_ENTRIES);
+    log_make_logs(&s, NUM_ENTRIES);
+    log_check(s.rows == NUM_ENTRIES, "row count");
+    log_store_get(&s, 1000, &r);
+    log_check(r.src_ip == 123000 && r.reference_time == 123000 && r.status == 1 && !r.URL[0] && !r.bro[0], "record 1000");
+
+    struct timeval start_time, stop_time, elapsed_time;
+    gettimeofday(&start_time,NULL);
+    for (i = 0; i < 100; i++)
+        log_traverse(&s);
+    gettimeofday(&stop_time,NULL);
+    timersub(&stop_time, &start_time, &elapsed_time);
+
+    for (i = 0; i < s.rows; i++)
+    {
+        log_check(s.src_ip[i] == 0 && s.reference_time[i] == 0, "traverse result");
+    }
+    printf("%f \n", elapsed_time.tv_sec+elapsed_time.tv_usec/1000000.0);
+
+    /* sparse table: only every 100th row stays active */
+    for (i = 0; i < s.rows; i++)
+    {
+        s.src_ip[i] = i * 123;
+        s.reference_time[i] = i * 123;
+        log_store_set_status(&s, i, i % 100 == 0);
+    }
+    uint32_t* active = malloc(s.rows * sizeof(uint32_t));
+    log_check(s.active_rows == (s.rows + 99) / 100, "active count");
+    log_check(log_active_rows(&s, 0, s.rows, active) == s.active_rows && active[1] == 100, "active rows");
+    log_check(log_active_next(&s, 1) == 100 && log_active_next(&s, s.rows - 1) == s.rows, "next active");
+    free(active);
+
+    gettimeofday(&start_time,NULL);
+    for (i = 0; i < 100; i++)
+        log_traverse(&s);
+    gettimeofday(&stop_time,NULL);
+    timersub(&stop_time, &start_time, &elapsed_time);
+    for (i = 0; i < s.rows; i++)
+    {
+        log_check(s.src_ip[i] == (i % 100 ? (int)(i * 123) : 0), "sparse traverse result");
+    }
+    /* strings round-trip through the cold store, and appending past capacity grows it */
+    LogRecord in = {7, "/index.html", 42, "Mozilla/5.0", 200};
+    i = log_store_append(&s, &in);
+    log_store_get(&s, i, &r);
+    log_check(memcmp(&in.URL, &r.URL, LOG_STR_LEN) == 0 && memcmp(&in.bro, &r.bro, LOG_STR_LEN) == 0 &&
+              r.src_ip == 7 && r.reference_time == 42 && r.status == 200, "appended record");
+    /* a string longer than a record field is cut so the copy back stays NUL-terminated */
+    char long_url[2 * LOG_STR_LEN];
+    memset(long_url, 'a', sizeof(long_url));
+    i = log_store_append_fields(&s, 7, long_url, sizeof(long_url), 42, "Mozilla/5.0", 11, 200);
+    log_store_get(&s, i, &r);
+    log_check(strnlen(r.URL, LOG_STR_LEN) == LOG_STR_MAX && strcmp(r.bro, "Mozilla/5.0") == 0, "long string cut");
+    /* serial, and partitioned over more threads than the machine may have */
+    s.threads = 1;
+    check_updates(&s);
+    s.threads = 3;
+    check_updates(&s);
+
+    printf("%f (1%% active)\n", elapsed_time.tv_sec+elapsed_time.tv_usec/1000000.0);
+    log_store_free(&s);
+
+    check_dict();
+    scaling(argc > 1 ? (size_t)atol(argv[1]) : NUM_ENTRIES);
+    return 0;
+}
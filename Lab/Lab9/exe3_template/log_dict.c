@@ -0,0 +1,136 @@
+/**
+ * String dictionary for the URL and browser columns.
+ * Each distinct string is stored once, NUL-terminated, in a growing arena and
+ * gets the next 32-bit code; rows keep only the code. Interning is
+ * hash-consed through an open-addressing table of codes (linear probing,
+ * load factor at most 1/2), so equal strings always get equal codes and a
+ * string predicate becomes an integer compare.
+ */
+#include "log_store.h"
+
+#define DICT_MIN_SLOTS 1024
+
+/* FNV-1a */
+uint32_t log_str_hash(const char* str, size_t len)
+{
+    uint32_t h = 2166136261u;
+    size_t i;
+    for (i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)str[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void log_dict_init(LogDict* d)
+{
+    memset(d, 0, sizeof(*d));
+    d->arena_cap = 4096;
+    d->arena = malloc(d->arena_cap);
+    d->code_cap = 256;
+    d->offset = malloc(d->code_cap * sizeof(uint32_t));
+    d->hash = malloc(d->code_cap * sizeof(uint32_t));
+    d->mask = DICT_MIN_SLOTS - 1;
+    d->slots = calloc(DICT_MIN_SLOTS, sizeof(uint32_t));
+}
+
+void log_dict_free(LogDict* d)
+{
+    free(d->arena);
+    free(d->offset);
+    free(d->hash);
+    free(d->slots);
+    memset(d, 0, sizeof(*d));
+}
+
+/* slot holding str, or the empty slot where it would go */
+static uint32_t* probe(const LogDict* d, const char* str, size_t len, uint32_t h)
+{
+    uint32_t i = h & d->mask;
+    while (d->slots[i])
+    {
+        uint32_t code = d->slots[i] - 1;
+        const char* s = d->arena + d->offset[code];
+        if (d->hash[code] == h && strncmp(s, str, len) == 0 && s[len] == 0)
+        {
+            break;
+        }
+        i = (i + 1) & d->mask;
+    }
+    return &d->slots[i];
+}
+
+static void rehash(LogDict* d)
+{
+    uint32_t n = (d->mask + 1) * 2, code;
+    free(d->slots);
+    d->slots = calloc(n, sizeof(uint32_t));
+    d->mask = n - 1;
+    for (code = 0; code < d->count; code++)
+    {
+        uint32_t i = d->hash[code] & d->mask;
+        while (d->slots[i])
+        {
+            i = (i + 1) & d->mask;
+        }
+        d->slots[i] = code + 1;
+    }
+}
+
+uint32_t log_dict_intern_n(LogDict* d, const char* str, size_t len)
+{
+    uint32_t h = log_str_hash(str, len);
+    uint32_t* slot = probe(d, str, len, h);
+    if (*slot)
+    {
+        return *slot - 1;
+    }
+
+    uint32_t code = d->count++;
+    if (d->count > d->code_cap)
+    {
+        d->code_cap *= 2;
+        d->offset = realloc(d->offset, d->code_cap * sizeof(uint32_t));
+        d->hash = realloc(d->hash, d->code_cap * sizeof(uint32_t));
+    }
+    while (d->arena_len + len + 1 > d->arena_cap)
+    {
+        d->arena_cap *= 2;
+        d->arena = realloc(d->arena, d->arena_cap);
+    }
+    if (!d->offset || !d->hash || !d->arena)
+    {
+        printf("log dictionary: out of memory\n");
+        exit(-1);
+    }
+    d->offset[code] = d->arena_len;
+    d->hash[code] = h;
+    memcpy(d->arena + d->arena_len, str, len);
+    d->arena[d->arena_len + len] = 0;
+    d->arena_len += len + 1;
+    *slot = code + 1;
+
+    if (2 * d->count > d->mask + 1)
+    {
+        rehash(d);
+    }
+    return code;
+}
+
+uint32_t log_dict_intern(LogDict* d, const char* str)
+{
+    return log_dict_intern_n(d, str, strlen(str));
+}
+
+uint32_t log_dict_find(const LogDict* d, const char* str)
+{
+    size_t len = strlen(str);
+    uint32_t* slot = probe(d, str, len, log_str_hash(str, len));
+    return *slot ? *slot - 1 : LOG_NO_CODE;
+}
+
+const char* log_dict_str(const LogDict* d, uint32_t code)
+{
+    return d->arena + d->offset[code];
+}
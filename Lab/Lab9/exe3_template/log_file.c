@@ -0,0 +1,304 @@
+/**
+ * On-disk log table that is used in place through mmap.
+ * The file is a header followed by every array of the store, each starting
+ * on a LOG_ALIGN boundary and padded to whole 64-row blocks, exactly as they
+ * sit in memory: the hot columns, the string code columns, the active bitmap,
+ * the time zone maps and both dictionaries including their hash slots. Opening maps the file
+ * and points the store at it, so there is nothing to parse or rebuild and
+ * pages are read as queries touch them. The mapping is private: updates such
+ * as traverse work on copy-on-write pages and never reach the file; save
+ * again to persist them. The first append copies the store to the heap.
+ */
+#include "log_store.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LOG_FILE_MAGIC "LOGCOLS"
+#define LOG_FILE_VERSION 2
+
+enum
+{
+    F_STATUS, F_SRC_IP, F_REFERENCE_TIME, F_URL, F_BRO, F_ACTIVE,
+    F_ZONE_MIN, F_ZONE_MAX, F_ZONE_UPTO,
+    F_URL_ARENA, F_URL_OFFSET, F_URL_HASH, F_URL_SLOTS,
+    F_BRO_ARENA, F_BRO_OFFSET, F_BRO_HASH, F_BRO_SLOTS,
+    LOG_FILE_ARRAYS
+};
+
+typedef struct LogFileDict
+{
+    uint64_t arena_len;
+    uint32_t count, mask;
+} LogFileDict;
+
+typedef struct LogFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t long_bytes;        /* sizeof(long) of the writer */
+    uint64_t rows, capacity, active_rows;
+    LogFileDict urls, bros;
+    uint64_t offset[LOG_FILE_ARRAYS], bytes[LOG_FILE_ARRAYS];
+} LogFileHeader;
+
+static size_t align_up(size_t n)
+{
+    return (n + LOG_ALIGN - 1) / LOG_ALIGN * LOG_ALIGN;
+}
+
+/* rows stored per column: whole 64-row blocks, at least one */
+static size_t file_capacity(const LogStore* s)
+{
+    return s->rows ? (s->rows + 63) / 64 * 64 : 64;
+}
+
+/* where each array of s lives in memory, and how many bytes it has */
+static void arrays(const LogStore* s, const void** p, uint64_t* bytes)
+{
+    size_t cap = file_capacity(s);
+    p[F_STATUS] = s->status;            bytes[F_STATUS] = cap * sizeof(int);
+    p[F_SRC_IP] = s->src_ip;            bytes[F_SRC_IP] = cap * sizeof(int);
+    p[F_REFERENCE_TIME] = s->reference_time; bytes[F_REFERENCE_TIME] = cap * sizeof(long);
+    p[F_URL] = s->URL;                  bytes[F_URL] = cap * sizeof(uint32_t);
+    p[F_BRO] = s->bro;                  bytes[F_BRO] = cap * sizeof(uint32_t);
+    p[F_ACTIVE] = s->active;            bytes[F_ACTIVE] = cap / 64 * sizeof(uint64_t);
+    p[F_ZONE_MIN] = s->zone_min;        bytes[F_ZONE_MIN] = cap / 64 * sizeof(long);
+    p[F_ZONE_MAX] = s->zone_max;        bytes[F_ZONE_MAX] = cap / 64 * sizeof(long);
+    p[F_ZONE_UPTO] = s->zone_upto;      bytes[F_ZONE_UPTO] = cap / 64 * sizeof(long);
+    p[F_URL_ARENA] = s->urls.arena;     bytes[F_URL_ARENA] = s->urls.arena_len;
+    p[F_URL_OFFSET] = s->urls.offset;   bytes[F_URL_OFFSET] = s->urls.count * sizeof(uint32_t);
+    p[F_URL_HASH] = s->urls.hash;       bytes[F_URL_HASH] = s->urls.count * sizeof(uint32_t);
+    p[F_URL_SLOTS] = s->urls.slots;     bytes[F_URL_SLOTS] = (s->urls.mask + 1) * sizeof(uint32_t);
+    p[F_BRO_ARENA] = s->bros.arena;     bytes[F_BRO_ARENA] = s->bros.arena_len;
+    p[F_BRO_OFFSET] = s->bros.offset;   bytes[F_BRO_OFFSET] = s->bros.count * sizeof(uint32_t);
+    p[F_BRO_HASH] = s->bros.hash;       bytes[F_BRO_HASH] = s->bros.count * sizeof(uint32_t);
+    p[F_BRO_SLOTS] = s->bros.slots;     bytes[F_BRO_SLOTS] = (s->bros.mask + 1) * sizeof(uint32_t);
+}
+
+int log_store_save(const LogStore* s, const char* path)
+{
+    LogFileHeader h;
+    const void* p[LOG_FILE_ARRAYS];
+    size_t pos = align_up(sizeof(h));
+    int i;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LOG_FILE_MAGIC, sizeof(h.magic));
+    h.version = LOG_FILE_VERSION;
+    h.long_bytes = sizeof(long);
+    h.rows = s->rows;
+    h.capacity = file_capacity(s);
+    h.active_rows = s->active_rows;
+    h.urls.arena_len = s->urls.arena_len;
+    h.urls.count = s->urls.count;
+    h.urls.mask = s->urls.mask;
+    h.bros.arena_len = s->bros.arena_len;
+    h.bros.count = s->bros.count;
+    h.bros.mask = s->bros.mask;
+    arrays(s, p, h.bytes);
+    for (i = 0; i < LOG_FILE_ARRAYS; i++)
+    {
+        h.offset[i] = pos;
+        pos = align_up(pos + h.bytes[i]);
+    }
+
+    FILE* f = fopen(path, "wb");
+    if (!f)
+    {
+        printf("cannot write %s\n", path);
+        return -1;
+    }
+    static const char zero[LOG_ALIGN];
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    size_t at = sizeof(h);
+    for (i = 0; i < LOG_FILE_ARRAYS && ok; i++)
+    {
+        ok = fwrite(zero, 1, h.offset[i] - at, f) == h.offset[i] - at;
+        ok = ok && fwrite(p[i], 1, h.bytes[i], f) == h.bytes[i];
+        at = h.offset[i] + h.bytes[i];
+    }
+    ok = ok && fwrite(zero, 1, pos - at, f) == pos - at;
+    if (fclose(f) != 0 || !ok)
+    {
+        printf("error writing %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * whether the header's geometry holds together: rows within a whole number of
+ * 64-row blocks, every array at least as long as those rows or the dictionary
+ * counts need, and within the file
+ */
+static int header_fits(const LogFileHeader* h, uint64_t size)
+{
+    uint64_t cap = h->capacity, need[LOG_FILE_ARRAYS];
+    const char* base = (const char*)h;
+    int i;
+    if (cap == 0 || cap % 64 != 0 || cap > size || h->rows > cap || h->active_rows > h->rows)
+    {
+        return 0;
+    }
+    if ((h->urls.mask & (h->urls.mask + 1ULL)) != 0 || h->urls.count > h->urls.mask
+        || (h->bros.mask & (h->bros.mask + 1ULL)) != 0 || h->bros.count > h->bros.mask)
+    {
+        return 0;
+    }
+    need[F_STATUS] = cap * sizeof(int);
+    need[F_SRC_IP] = cap * sizeof(int);
+    need[F_REFERENCE_TIME] = cap * sizeof(long);
+    need[F_URL] = cap * sizeof(uint32_t);
+    need[F_BRO] = cap * sizeof(uint32_t);
+    need[F_ACTIVE] = cap / 64 * sizeof(uint64_t);
+    need[F_ZONE_MIN] = cap / 64 * sizeof(long);
+    need[F_ZONE_MAX] = cap / 64 * sizeof(long);
+    need[F_ZONE_UPTO] = cap / 64 * sizeof(long);
+    need[F_URL_ARENA] = h->urls.arena_len;
+    need[F_URL_OFFSET] = (uint64_t)h->urls.count * sizeof(uint32_t);
+    need[F_URL_HASH] = (uint64_t)h->urls.count * sizeof(uint32_t);
+    need[F_URL_SLOTS] = (h->urls.mask + 1ULL) * sizeof(uint32_t);
+    need[F_BRO_ARENA] = h->bros.arena_len;
+    need[F_BRO_OFFSET] = (uint64_t)h->bros.count * sizeof(uint32_t);
+    need[F_BRO_HASH] = (uint64_t)h->bros.count * sizeof(uint32_t);
+    need[F_BRO_SLOTS] = (h->bros.mask + 1ULL) * sizeof(uint32_t);
+    for (i = 0; i < LOG_FILE_ARRAYS; i++)
+    {
+        if (h->offset[i] % LOG_ALIGN != 0 || h->bytes[i] < need[i] || h->bytes[i] > size
+            || h->offset[i] > size - h->bytes[i])
+        {
+            return 0;
+        }
+    }
+    /* strings are read up to their NUL, so each arena must end in one */
+    if ((h->urls.arena_len && base[h->offset[F_URL_ARENA] + h->urls.arena_len - 1] != 0)
+        || (h->bros.arena_len && base[h->offset[F_BRO_ARENA] + h->bros.arena_len - 1] != 0))
+    {
+        return 0;
+    }
+    return 1;
+}
+
+int log_store_map(LogStore* s, const char* path)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(LogFileHeader))
+    {
+        printf("cannot open %s\n", path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    char* base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        printf("cannot map %s\n", path);
+        return -1;
+    }
+
+    const LogFileHeader* h = (const LogFileHeader*)base;
+    if (memcmp(h->magic, LOG_FILE_MAGIC, sizeof(h->magic)) != 0 || h->version != LOG_FILE_VERSION
+        || h->long_bytes != sizeof(long))
+    {
+        printf("%s is not a version %d log table\n", path, LOG_FILE_VERSION);
+        munmap(base, st.st_size);
+        return -1;
+    }
+    if (!header_fits(h, st.st_size))
+    {
+        printf("%s: header does not match its arrays (truncated or damaged table)\n", path);
+        munmap(base, st.st_size);
+        return -1;
+    }
+
+    memset(s, 0, sizeof(*s));
+    s->rows = h->rows;
+    s->capacity = h->capacity;
+    s->active_rows = h->active_rows;
+    s->status = (int*)(base + h->offset[F_STATUS]);
+    s->src_ip = (int*)(base + h->offset[F_SRC_IP]);
+    s->reference_time = (long*)(base + h->offset[F_REFERENCE_TIME]);
+    s->URL = (uint32_t*)(base + h->offset[F_URL]);
+    s->bro = (uint32_t*)(base + h->offset[F_BRO]);
+    s->active = (uint64_t*)(base + h->offset[F_ACTIVE]);
+    s->zone_min = (long*)(base + h->offset[F_ZONE_MIN]);
+    s->zone_max = (long*)(base + h->offset[F_ZONE_MAX]);
+    s->zone_upto = (long*)(base + h->offset[F_ZONE_UPTO]);
+
+    s->urls.arena = base + h->offset[F_URL_ARENA];
+    s->urls.arena_len = s->urls.arena_cap = h->urls.arena_len;
+    s->urls.offset = (uint32_t*)(base + h->offset[F_URL_OFFSET]);
+    s->urls.hash = (uint32_t*)(base + h->offset[F_URL_HASH]);
+    s->urls.slots = (uint32_t*)(base + h->offset[F_URL_SLOTS]);
+    s->urls.count = s->urls.code_cap = h->urls.count;
+    s->urls.mask = h->urls.mask;
+
+    s->bros.arena = base + h->offset[F_BRO_ARENA];
+    s->bros.arena_len = s->bros.arena_cap = h->bros.arena_len;
+    s->bros.offset = (uint32_t*)(base + h->offset[F_BRO_OFFSET]);
+    s->bros.hash = (uint32_t*)(base + h->offset[F_BRO_HASH]);
+    s->bros.slots = (uint32_t*)(base + h->offset[F_BRO_SLOTS]);
+    s->bros.count = s->bros.code_cap = h->bros.count;
+    s->bros.mask = h->bros.mask;
+
+    s->map = base;
+    s->map_bytes = st.st_size;
+    /* not part of the file: every row is new to this process */
+    s->dirty = calloc((s->capacity / 64 + 63) / 64, sizeof(uint64_t));
+    if (!s->dirty)
+    {
+        printf("log store: out of memory\n");
+        exit(-1);
+    }
+    log_mark_dirty(s, 0, s->rows);
+    return 0;
+}
+
+static void* heap_copy(const void* p, size_t used, size_t bytes, size_t align)
+{
+    void* q = align ? aligned_alloc(align, align_up(bytes)) : malloc(bytes ? bytes : 1);
+    if (!q)
+    {
+        printf("log store: out of memory (%zu bytes)\n", bytes);
+        exit(-1);
+    }
+    memcpy(q, p, used);
+    return q;
+}
+
+static void dict_to_heap(LogDict* d)
+{
+    size_t slots = (d->mask + 1) * sizeof(uint32_t);
+    d->arena_cap = d->arena_len > 4096 ? d->arena_len : 4096;
+    d->code_cap = d->count > 256 ? d->count : 256;
+    d->arena = heap_copy(d->arena, d->arena_len, d->arena_cap, 0);
+    d->offset = heap_copy(d->offset, d->count * sizeof(uint32_t), d->code_cap * sizeof(uint32_t), 0);
+    d->hash = heap_copy(d->hash, d->count * sizeof(uint32_t), d->code_cap * sizeof(uint32_t), 0);
+    d->slots = heap_copy(d->slots, slots, slots, 0);
+}
+
+void log_store_unmap(LogStore* s)
+{
+    size_t cap = s->capacity;
+    if (!s->map)
+    {
+        return;
+    }
+    s->status = heap_copy(s->status, cap * sizeof(int), cap * sizeof(int), LOG_ALIGN);
+    s->src_ip = heap_copy(s->src_ip, cap * sizeof(int), cap * sizeof(int), LOG_ALIGN);
+    s->reference_time = heap_copy(s->reference_time, cap * sizeof(long), cap * sizeof(long), LOG_ALIGN);
+    s->URL = heap_copy(s->URL, cap * sizeof(uint32_t), cap * sizeof(uint32_t), LOG_ALIGN);
+    s->bro = heap_copy(s->bro, cap * sizeof(uint32_t), cap * sizeof(uint32_t), LOG_ALIGN);
+    s->active = heap_copy(s->active, cap / 64 * sizeof(uint64_t), cap / 64 * sizeof(uint64_t), LOG_ALIGN);
+    s->zone_min = heap_copy(s->zone_min, cap / 64 * sizeof(long), cap / 64 * sizeof(long), LOG_ALIGN);
+    s->zone_max = heap_copy(s->zone_max, cap / 64 * sizeof(long), cap / 64 * sizeof(long), LOG_ALIGN);
+    s->zone_upto = heap_copy(s->zone_upto, cap / 64 * sizeof(long), cap / 64 * sizeof(long), LOG_ALIGN);
+    dict_to_heap(&s->urls);
+    dict_to_heap(&s->bros);
+    munmap(s->map, s->map_bytes);
+    s->map = NULL;
+    s->map_bytes = 0;
+}
@@ -0,0 +1,260 @@
+/**
+ * Secondary hash index from src_ip to the rows that hold it.
+ * Keys live in an open-addressing table (linear probing, load factor at most
+ * 1/2). Each key owns a postings list of row numbers: rows only ever grow, so
+ * the list stores the gap to the previous row as a varint, packed into
+ * 32-byte blocks chained from the key's entry. A typical gap takes 2-3 bytes
+ * instead of 4. Append adds the new row to the tail block of its key, so the
+ * index never needs a rebuild while the table only grows.
+ *
+ * Batched lookups go through the keys in windows: first every slot of the
+ * window is prefetched, then every first postings block, then the lists are
+ * decoded, so the cache misses of one window overlap instead of queueing.
+ */
+#include "log_store.h"
+
+#define IDX_MIN_SLOTS 1024
+#define IDX_BLOCK_BYTES 32
+/* keys looked up together by log_ip_lookup_many */
+#define IDX_WINDOW 16
+
+typedef struct IpBlock
+{
+    uint32_t next;              /* next block of the list, 0 at the end */
+    uint8_t used;
+    uint8_t data[IDX_BLOCK_BYTES - 5];
+} IpBlock;
+
+typedef struct IpEntry
+{
+    int key;
+    uint32_t count;             /* 0 marks an empty slot */
+    uint32_t last;              /* last row, the base of the next gap */
+    uint32_t head, tail;        /* first and last block */
+} IpEntry;
+
+typedef struct LogIpIndex
+{
+    IpEntry* slots;
+    uint32_t mask, used;
+    IpBlock* blocks;            /* block 0 is unused, so 0 can end a list */
+    uint32_t nblocks, block_cap;
+} LogIpIndex;
+
+static inline uint32_t ip_hash(int key)
+{
+    uint64_t h = (uint64_t)(uint32_t)key * 0x9e3779b97f4a7c15ull;
+    return (uint32_t)(h >> 32);
+}
+
+static void* idx_alloc(void* p, size_t bytes)
+{
+    p = realloc(p, bytes);
+    if (!p)
+    {
+        printf("log index: out of memory\n");
+        exit(-1);
+    }
+    return p;
+}
+
+static inline IpEntry* idx_probe(const LogIpIndex* x, int key)
+{
+    uint32_t i = ip_hash(key) & x->mask;
+    while (x->slots[i].count && x->slots[i].key != key)
+    {
+        i = (i + 1) & x->mask;
+    }
+    return &x->slots[i];
+}
+
+static void idx_rehash(LogIpIndex* x)
+{
+    IpEntry* old = x->slots;
+    uint32_t i, n = x->mask + 1;
+    x->slots = calloc(2 * (size_t)n, sizeof(IpEntry));
+    if (!x->slots)
+    {
+        printf("log index: out of memory\n");
+        exit(-1);
+    }
+    x->mask = 2 * n - 1;
+    for (i = 0; i < n; i++)
+    {
+        if (old[i].count)
+            *idx_probe(x, old[i].key) = old[i];
+    }
+    free(old);
+}
+
+static uint32_t idx_new_block(LogIpIndex* x)
+{
+    if (x->nblocks == x->block_cap)
+    {
+        x->block_cap *= 2;
+        x->blocks = idx_alloc(x->blocks, (size_t)x->block_cap * sizeof(IpBlock));
+    }
+    IpBlock* b = &x->blocks[x->nblocks];
+    b->next = 0;
+    b->used = 0;
+    return x->nblocks++;
+}
+
+void log_ip_index_add(LogStore* s, int src_ip, size_t row)
+{
+    LogIpIndex* x = s->ip_index;
+    IpEntry* e = idx_probe(x, src_ip);
+    uint8_t buf[5];
+    int len = 0;
+
+    if (!e->count)
+    {
+        if (2 * (x->used + 1) > x->mask + 1)
+        {
+            idx_rehash(x);
+            e = idx_probe(x, src_ip);
+        }
+        uint32_t b = idx_new_block(x);
+        x->used++;
+        e->key = src_ip;
+        e->last = 0;
+        e->head = e->tail = b;
+    }
+
+    /* the first gap is the row itself */
+    uint32_t gap = (uint32_t)row - e->last;
+    do
+    {
+        buf[len++] = (gap & 0x7f) | (gap > 0x7f ? 0x80 : 0);
+        gap >>= 7;
+    } while (gap);
+
+    IpBlock* t = &x->blocks[e->tail];
+    if (t->used + len > (int)sizeof(t->data))
+    {
+        uint32_t b = idx_new_block(x);
+        /* the pool may have moved */
+        x->blocks[e->tail].next = b;
+        e->tail = b;
+        t = &x->blocks[b];
+    }
+    memcpy(t->data + t->used, buf, len);
+    t->used += len;
+    e->last = row;
+    e->count++;
+}
+
+void log_ip_index_build(LogStore* s)
+{
+    size_t i;
+    log_ip_index_drop(s);
+    LogIpIndex* x = calloc(1, sizeof(LogIpIndex));
+    x->slots = calloc(IDX_MIN_SLOTS, sizeof(IpEntry));
+    x->mask = IDX_MIN_SLOTS - 1;
+    x->block_cap = IDX_MIN_SLOTS;
+    x->blocks = idx_alloc(NULL, (size_t)x->block_cap * sizeof(IpBlock));
+    x->nblocks = 1;
+    if (!x->slots)
+    {
+        printf("log index: out of memory\n");
+        exit(-1);
+    }
+    s->ip_index = x;
+    for (i = 0; i < s->rows; i++)
+    {
+        log_ip_index_add(s, s->src_ip[i], i);
+    }
+}
+
+void log_ip_index_drop(LogStore* s)
+{
+    if (s->ip_index)
+    {
+        free(s->ip_index->slots);
+        free(s->ip_index->blocks);
+        free(s->ip_index);
+        s->ip_index = NULL;
+    }
+}
+
+size_t log_ip_index_bytes(const LogStore* s)
+{
+    const LogIpIndex* x = s->ip_index;
+    return x ? (x->mask + 1) * sizeof(IpEntry) + (size_t)x->block_cap * sizeof(IpBlock) : 0;
+}
+
+/* decodes the postings of e into out, at most max of them */
+static size_t decode(const LogIpIndex* x, const IpEntry* e, uint32_t* out, size_t max)
+{
+    uint32_t b, row = 0;
+    size_t n = 0;
+    if (!e->count)
+    {
+        return 0;
+    }
+    for (b = e->head; b && n < max; b = x->blocks[b].next)
+    {
+        const IpBlock* blk = &x->blocks[b];
+        int i = 0;
+        while (i < blk->used && n < max)
+        {
+            uint32_t gap = 0;
+            int shift = 0;
+            uint8_t c;
+            do
+            {
+                c = blk->data[i++];
+                gap |= (uint32_t)(c & 0x7f) << shift;
+                shift += 7;
+            } while (c & 0x80);
+            row += gap;
+            out[n++] = row;
+        }
+    }
+    return e->count;
+}
+
+static void need_index(const LogStore* s)
+{
+    if (!s->ip_index)
+    {
+        printf("log index: no src_ip index, call log_ip_index_build first\n");
+        exit(-1);
+    }
+}
+
+size_t log_ip_lookup(const LogStore* s, int src_ip, uint32_t* out, size_t max)
+{
+    need_index(s);
+    return decode(s->ip_index, idx_probe(s->ip_index, src_ip), out, max);
+}
+
+size_t log_ip_lookup_many(const LogStore* s, const int* ips, size_t n, uint32_t* out, size_t max, size_t* counts)
+{
+    const LogIpIndex* x;
+    const IpEntry* e[IDX_WINDOW];
+    size_t w, k, total = 0;
+    need_index(s);
+    x = s->ip_index;
+
+    for (w = 0; w < n; w += IDX_WINDOW)
+    {
+        size_t end = w + IDX_WINDOW < n ? w + IDX_WINDOW : n;
+        for (k = w; k < end; k++)
+        {
+            __builtin_prefetch(&x->slots[ip_hash(ips[k]) & x->mask]);
+        }
+        for (k = w; k < end; k++)
+        {
+            e[k - w] = idx_probe(x, ips[k]);
+            __builtin_prefetch(&x->blocks[e[k - w]->head]);
+        }
+        for (k = w; k < end; k++)
+        {
+            size_t c = decode(x, e[k - w], out + (total < max ? total : max), total < max ? max - total : 0);
+            counts[k] = c;
+            total += c;
+        }
+    }
+    return total;
+}
@@ -0,0 +1,115 @@
+/**
+ * src_ip lookups on a table of synthetic traffic through the hash index:
+ * point lookups and an IN-list of 1000 addresses are checked against a full
+ * scan, the index is checked again after appends (which it follows) and after
+ * traverse (which drops it), and lookups are timed against the scan, one by
+ * one and batched.
+ *
+ * Usage: ./log_ip [rows]
+ */
+#include "log_store.h"
+
+static size_t scan_ip(const LogStore* s, int ip, uint32_t* out)
+{
+    size_t i, n = 0;
+    for (i = 0; i < s->rows; i++)
+    {
+        if (s->src_ip[i] == ip)
+            out[n++] = i;
+    }
+    return n;
+}
+
+/* every address in ips, and one that is not in the table, against the scan */
+static void check_lookups(const LogStore* s, const int* ips, size_t n, uint32_t* a, uint32_t* b, const char* what)
+{
+    size_t k, total = 0, got;
+    size_t* counts = malloc(n * sizeof(size_t));
+    for (k = 0; k < n; k++)
+    {
+        size_t c = scan_ip(s, ips[k], b);
+        log_check(log_ip_lookup(s, ips[k], a, s->rows) == c && memcmp(a, b, c * sizeof(uint32_t)) == 0, what);
+        total += c;
+    }
+    log_check(log_ip_lookup(s, 0x7f000001, a, s->rows) == 0, what);
+
+    uint32_t* many = malloc((total + 1) * sizeof(uint32_t));
+    got = log_ip_lookup_many(s, ips, n, many, total, counts);
+    log_check(got == total, what);
+    for (k = 0, total = 0; k < n; k++)
+    {
+        size_t c = scan_ip(s, ips[k], b);
+        log_check(counts[k] == c && memcmp(many + total, b, c * sizeof(uint32_t)) == 0, what);
+        total += c;
+    }
+    free(many);
+    free(counts);
+}
+
+int main(int argc, char** argv)
+{
+    size_t rows = argc > 1 ? (size_t)atol(argv[1]) : NUM_ENTRIES, k;
+    LogStore s;
+    int ips[1000];
+    int r;
+    if (rows < 1)
+    {
+        rows = 1;
+    }
+    log_store_init(&s, rows);
+    log_make_traffic(&s, rows, 1);
+    uint32_t* a = malloc((rows + 1000) * sizeof(uint32_t));
+    uint32_t* b = malloc((rows + 1000) * sizeof(uint32_t));
+    size_t* counts = malloc(1000 * sizeof(size_t));
+
+    double t0 = log_now();
+    log_ip_index_build(&s);
+    double t1 = log_now();
+    printf("index built in %f s: %zu bytes, src_ip column %zu bytes\n", t1 - t0, log_ip_index_bytes(&s),
+           rows * sizeof(int));
+
+    srand(1);
+    for (k = 0; k < 1000; k++)
+        ips[k] = s.src_ip[rand() % rows];
+    check_lookups(&s, ips, 1000, a, b, "lookup");
+
+    /* appends follow the index: known addresses, a new one, rows past a grow */
+    LogRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    for (k = 0; k < 1000; k++)
+    {
+        rec.src_ip = k % 3 ? ips[k] : 0x7f000002;
+        rec.status = 200;
+        log_store_append(&s, &rec);
+    }
+    ips[999] = 0x7f000002;
+    check_lookups(&s, ips, 1000, a, b, "lookup after append");
+
+    /* timings on the grown table */
+    double t2 = log_now();
+    for (r = 0; r < 10; r++)
+        scan_ip(&s, ips[r], b);
+    double t3 = log_now();
+    for (r = 0; r < 10; r++)
+        for (k = 0; k < 1000; k++)
+            log_ip_lookup(&s, ips[k], a, s.rows);
+    double t4 = log_now();
+    for (r = 0; r < 10; r++)
+        log_ip_lookup_many(&s, ips, 1000, a, rows + 1000, counts);
+    double t5 = log_now();
+    printf("per address: full scan %.2f us, index %.3f us one by one, %.3f us batched\n", (t3 - t2) / 10 * 1e6,
+           (t4 - t3) / 10000 * 1e6, (t5 - t4) / 10000 * 1e6);
+
+    /* traverse rewrites src_ip, so the index goes and is built again on demand */
+    log_traverse(&s);
+    log_check(s.ip_index == NULL, "index dropped by traverse");
+    log_ip_index_build(&s);
+    ips[0] = 0;
+    check_lookups(&s, ips, 1000, a, b, "lookup after traverse");
+
+    free(a);
+    free(b);
+    free(counts);
+    log_store_free(&s);
+    return 0;
+}
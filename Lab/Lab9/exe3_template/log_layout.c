@@ -0,0 +1,304 @@
+/**
+ * Layout study for struct log_entry: the traverse() pass of log_base.c over
+ * four layouts of the same rows,
+ *   aos        the field order of log_base.c
+ *   reordered  the order of log_fast.c, hot fields first
+ *   split      hot fields in one array of 16-byte rows, strings in another
+ *   soa        one array per field
+ * at several table sizes. The Makefile builds this file at -O0 to -O3, one
+ * binary per level. Each pass is timed with CLOCK_MONOTONIC, best of three,
+ * and counted with perf_event_open (cache misses, L1d read misses and
+ * instructions, user space only); a counter the kernel or the machine does not
+ * offer reads -1. Bytes/row is the size of the arrays the pass walks, divided
+ * by the rows.
+ *
+ * Usage: ./log_layout_O2 [rows ...]
+ */
+#include "log_store.h"
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#ifndef LAYOUT_OPT
+#define LAYOUT_OPT "?"
+#endif
+
+/* rows a size is passed over in total, so small tables are timed as long as big ones */
+#define LAYOUT_WORK (8L << 20)
+
+struct entry_aos
+{
+    int src_ip;
+    char URL[128];
+    long reference_time;
+    char bro[128];
+    int status;
+};
+
+struct entry_reordered
+{
+    int src_ip;
+    int status;
+    long reference_time;
+    char URL[128];
+    char bro[128];
+};
+
+struct entry_hot
+{
+    long reference_time;
+    int src_ip;
+    int status;
+};
+
+struct entry_cold
+{
+    char URL[128];
+    char bro[128];
+};
+
+typedef struct Table
+{
+    size_t n;
+    void* rows;                 /* aos, reordered and split: the rows the pass walks */
+    struct entry_cold* cold;    /* split and soa: the strings, never read by the pass */
+    int* status;                /* soa */
+    int* src_ip;
+    long* reference_time;
+} Table;
+
+static void* table_alloc(size_t bytes)
+{
+    void* p = aligned_alloc(64, (bytes + 63) / 64 * 64);
+    if (!p)
+    {
+        printf("log layout: out of memory (%zu bytes)\n", bytes);
+        exit(-1);
+    }
+    /* touch every page now, not during the first timed pass */
+    memset(p, 0, bytes);
+    return p;
+}
+
+/* make, traverse and check functions of a layout; STATUS(i), SRC_IP(i) and REFERENCE_TIME(i) are the fields of row i of t */
+#define LAYOUT(name, STATUS, SRC_IP, REFERENCE_TIME)                        \
+    static void make_##name(Table* t)                                       \
+    {                                                                       \
+        size_t i;                                                           \
+        for (i = 0; i < t->n; i++)                                          \
+        {                                                                   \
+            SRC_IP(i) = i * 123;                                            \
+            REFERENCE_TIME(i) = i * 123;                                    \
+            STATUS(i) = 1;                                                  \
+        }                                                                   \
+    }                                                                       \
+    static void traverse_##name(Table* t)                                   \
+    {                                                                       \
+        size_t i;                                                           \
+        for (i = 0; i < t->n; i++)                                          \
+        {                                                                   \
+            if (STATUS(i))                                                  \
+            {                                                               \
+                REFERENCE_TIME(i) = 0;                                      \
+                SRC_IP(i) = 0;                                              \
+            }                                                               \
+        }                                                                   \
+    }                                                                       \
+    static int reset_##name(const Table* t)                                 \
+    {                                                                       \
+        size_t i;                                                           \
+        for (i = 0; i < t->n; i++)                                          \
+            if (SRC_IP(i) || REFERENCE_TIME(i)) return 0;                   \
+        return 1;                                                           \
+    }
+
+#define AOS(i, f) (((struct entry_aos*)t->rows)[i].f)
+#define AOS_STATUS(i) AOS(i, status)
+#define AOS_SRC_IP(i) AOS(i, src_ip)
+#define AOS_TIME(i) AOS(i, reference_time)
+LAYOUT(aos, AOS_STATUS, AOS_SRC_IP, AOS_TIME)
+
+#define REO(i, f) (((struct entry_reordered*)t->rows)[i].f)
+#define REO_STATUS(i) REO(i, status)
+#define REO_SRC_IP(i) REO(i, src_ip)
+#define REO_TIME(i) REO(i, reference_time)
+LAYOUT(reordered, REO_STATUS, REO_SRC_IP, REO_TIME)
+
+#define HOT(i, f) (((struct entry_hot*)t->rows)[i].f)
+#define HOT_STATUS(i) HOT(i, status)
+#define HOT_SRC_IP(i) HOT(i, src_ip)
+#define HOT_TIME(i) HOT(i, reference_time)
+LAYOUT(split, HOT_STATUS, HOT_SRC_IP, HOT_TIME)
+
+#define SOA_STATUS(i) (t->status[i])
+#define SOA_SRC_IP(i) (t->src_ip[i])
+#define SOA_TIME(i) (t->reference_time[i])
+LAYOUT(soa, SOA_STATUS, SOA_SRC_IP, SOA_TIME)
+
+typedef struct Layout
+{
+    const char* name;
+    int columns;                /* one array per hot field */
+    size_t row_bytes;           /* of the arrays the pass walks */
+    size_t cold_bytes;
+    void (*make)(Table* t);
+    void (*traverse)(Table* t);
+    int (*reset)(const Table* t);
+} Layout;
+
+static const Layout layouts[] =
+{
+    {"aos", 0, sizeof(struct entry_aos), 0, make_aos, traverse_aos, reset_aos},
+    {"reordered", 0, sizeof(struct entry_reordered), 0, make_reordered, traverse_reordered, reset_reordered},
+    {"split", 0, sizeof(struct entry_hot), sizeof(struct entry_cold), make_split, traverse_split, reset_split},
+    {"soa", 1, 2 * sizeof(int) + sizeof(long), sizeof(struct entry_cold), make_soa, traverse_soa, reset_soa},
+};
+
+static void table_init(Table* t, const Layout* l, size_t n)
+{
+    memset(t, 0, sizeof(*t));
+    t->n = n;
+    if (l->columns)
+    {
+        t->status = table_alloc(n * sizeof(int));
+        t->src_ip = table_alloc(n * sizeof(int));
+        t->reference_time = table_alloc(n * sizeof(long));
+    }
+    else
+    {
+        t->rows = table_alloc(n * l->row_bytes);
+    }
+    if (l->cold_bytes)
+    {
+        t->cold = table_alloc(n * l->cold_bytes);
+    }
+    l->make(t);
+}
+
+static void table_free(Table* t)
+{
+    free(t->rows);
+    free(t->cold);
+    free(t->status);
+    free(t->src_ip);
+    free(t->reference_time);
+}
+
+/* hardware counters of this thread in user space; fd -1 when unavailable */
+enum { C_CACHE_MISSES, C_L1D_MISSES, C_INSTRUCTIONS, COUNTERS };
+
+static int counter_open(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.size = sizeof(a);
+    a.type = type;
+    a.config = config;
+    a.disabled = 1;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+static void counters_open(int* fd)
+{
+    fd[C_CACHE_MISSES] = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fd[C_L1D_MISSES] = counter_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8
+                                    | PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    fd[C_INSTRUCTIONS] = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+}
+
+static void counters_start(const int* fd)
+{
+    int c;
+    for (c = 0; c < COUNTERS; c++)
+    {
+        if (fd[c] >= 0)
+        {
+            ioctl(fd[c], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd[c], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+static void counters_stop(const int* fd, long* value)
+{
+    int c;
+    for (c = 0; c < COUNTERS; c++)
+    {
+        uint64_t v;
+        value[c] = -1;
+        if (fd[c] >= 0)
+        {
+            ioctl(fd[c], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd[c], &v, sizeof(v)) == sizeof(v))
+                value[c] = (long)v;
+        }
+    }
+}
+
+/* a count per row and pass, or -1 */
+static double per_row(long count, size_t rows, long passes)
+{
+    return count < 0 ? -1 : (double)count / rows / passes;
+}
+
+static void run(const Layout* l, size_t n, const int* fd)
+{
+    Table t;
+    long passes = LAYOUT_WORK / (long)n, p, value[COUNTERS];
+    double best = 0;
+    int rep;
+    if (passes < 3)
+    {
+        passes = 3;
+    }
+    table_init(&t, l, n);
+    /* the first pass resets the rows; the timed ones rewrite the zeros, like log_base.c's 99 later passes */
+    l->traverse(&t);
+    log_check(l->reset(&t), l->name);
+    for (rep = 0; rep < 3; rep++)
+    {
+        double t0 = log_now();
+        for (p = 0; p < passes; p++)
+            l->traverse(&t);
+        double t1 = log_now() - t0;
+        best = rep == 0 || t1 < best ? t1 : best;
+    }
+    counters_start(fd);
+    for (p = 0; p < passes; p++)
+        l->traverse(&t);
+    counters_stop(fd, value);
+
+    printf("%-4s %-10s %9zu %9.3f %6zu %9.3f %9.3f %9.2f\n", LAYOUT_OPT, l->name, n, best / passes / n * 1e9,
+           l->row_bytes, per_row(value[C_CACHE_MISSES], n, passes), per_row(value[C_L1D_MISSES], n, passes),
+           per_row(value[C_INSTRUCTIONS], n, passes));
+    table_free(&t);
+}
+
+int main(int argc, char** argv)
+{
+    size_t sizes[16] = {4096, 65536, 409600, 1638400};
+    int nsizes = 4, i, k, fd[COUNTERS];
+    if (argc > 1)
+    {
+        for (nsizes = 0; nsizes < argc - 1 && nsizes < 16; nsizes++)
+        {
+            long n = atol(argv[nsizes + 1]);
+            sizes[nsizes] = n > 0 ? (size_t)n : 1;
+        }
+    }
+    counters_open(fd);
+    printf("%-4s %-10s %9s %9s %6s %9s %9s %9s\n", "opt", "layout", "rows", "ns/row", "B/row", "miss/row",
+           "L1d/row", "instr/row");
+    for (i = 0; i < nsizes; i++)
+        for (k = 0; k < (int)(sizeof(layouts) / sizeof(layouts[0])); k++)
+            run(&layouts[k], sizes[i], fd);
+    for (k = 0; k < COUNTERS; k++)
+    {
+        if (fd[k] >= 0)
+            close(fd[k]);
+    }
+    return 0;
+}
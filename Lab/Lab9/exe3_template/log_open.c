@@ -0,0 +1,103 @@
+/**
+ * Saves a table of synthetic traffic, maps it back and checks that the
+ * mapped table answers exactly like the one in memory, and that copies with
+ * a damaged or truncated header are refused. Prints how long it takes to
+ * build the table, to save it and to open it again.
+ *
+ * Usage: ./log_open <table file> [rows]
+ */
+#include "log_store.h"
+
+/* copies the table at path to bad with the 64-bit header word at byte at set to v, or cut to len bytes */
+static void damage(const char* path, const char* bad, size_t at, uint64_t v, long len)
+{
+    FILE* f = fopen(path, "rb");
+    log_check(f != NULL, "reopen table");
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    char* buf = malloc(n);
+    fseek(f, 0, SEEK_SET);
+    log_check(fread(buf, 1, n, f) == (size_t)n, "read table");
+    fclose(f);
+    if (len < 0)
+    {
+        memcpy(buf + at, &v, sizeof(v));
+        len = n;
+    }
+    f = fopen(bad, "wb");
+    log_check(f != NULL && fwrite(buf, 1, len, f) == (size_t)len && fclose(f) == 0, "write damaged table");
+    free(buf);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: ./log_open <table file> [rows]\n");
+        exit(0);
+    }
+    size_t rows = argc > 2 ? (size_t)atol(argv[2]) : NUM_ENTRIES;
+    LogStore mem, map;
+    LogRecord a, b;
+    size_t i;
+
+    double t0 = log_now();
+    log_store_init(&mem, rows);
+    log_make_traffic(&mem, rows, 1);
+    double t1 = log_now();
+    if (log_store_save(&mem, argv[1]) != 0)
+    {
+        exit(-1);
+    }
+    double t2 = log_now();
+    if (log_store_map(&map, argv[1]) != 0)
+    {
+        exit(-1);
+    }
+    double t3 = log_now();
+    printf("build %f s, save %f s, open %f s (%zu rows, %zu bytes)\n", t1 - t0, t2 - t1, t3 - t2, map.rows, map.map_bytes);
+
+    log_check(map.rows == mem.rows && map.active_rows == mem.active_rows, "row counts");
+    log_check(((uintptr_t)map.status | (uintptr_t)map.reference_time | (uintptr_t)map.URL) % LOG_ALIGN == 0, "column alignment");
+    for (i = 0; i < rows; i++)
+    {
+        log_store_get(&mem, i, &a);
+        log_store_get(&map, i, &b);
+        log_check(a.src_ip == b.src_ip && a.reference_time == b.reference_time && a.status == b.status
+                  && strcmp(a.URL, b.URL) == 0 && strcmp(a.bro, b.bro) == 0, "mapped record");
+    }
+    log_check(log_dict_find(&map.urls, "/page1.html") == log_dict_find(&mem.urls, "/page1.html"), "mapped dictionary");
+
+    /* updates run on the private mapping exactly as in memory */
+    LogPred pred = {LOG_COL_URL, LOG_EQ, log_dict_find(&mem.urls, "/page1.html")};
+    LogSet set = {LOG_COL_STATUS, 0};
+    log_check(log_update_where(&mem, pred, &set, 1) == log_update_where(&map, pred, &set, 1), "mapped update");
+    log_traverse(&mem);
+    log_traverse(&map);
+    log_check(memcmp(mem.src_ip, map.src_ip, rows * sizeof(int)) == 0 && mem.active_rows == map.active_rows, "mapped traverse");
+
+    /* appending moves the mapped table to the heap */
+    memset(&a, 0, sizeof(a));
+    strcpy(a.URL, "/new.html");
+    log_store_append(&map, &a);
+    log_check(!map.map && map.rows == rows + 1 && log_dict_find(&map.urls, "/new.html") != LOG_NO_CODE, "append after map");
+
+    /* damaged headers are refused, not mapped short: rows and capacity are the words at bytes 16 and 24 */
+    char bad[512];
+    LogStore d;
+    uint64_t cap = (rows + 63) / 64 * 64;
+    snprintf(bad, sizeof(bad), "%s.bad", argv[1]);
+    damage(argv[1], bad, 16, cap + 1, -1);
+    log_check(log_store_map(&d, bad) != 0, "rows beyond capacity");
+    damage(argv[1], bad, 24, cap * 2, -1);
+    log_check(log_store_map(&d, bad) != 0, "capacity beyond the column arrays");
+    damage(argv[1], bad, 24, cap + 1, -1);
+    log_check(log_store_map(&d, bad) != 0, "capacity not whole blocks");
+    damage(argv[1], bad, 0, 0, 4096);
+    log_check(log_store_map(&d, bad) != 0, "truncated table");
+    remove(bad);
+
+    log_store_free(&mem);
+    log_store_free(&map);
+    return 0;
+}
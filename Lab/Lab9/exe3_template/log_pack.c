@@ -0,0 +1,316 @@
+/**
+ * Block-compressed reference_time column.
+ * Values are cut into blocks of LOG_PACK_ROWS. Each block keeps its min and
+ * max in a header and stores every value as an offset from the block min,
+ * bit-packed at the width of the largest offset (frame of reference). When
+ * the deltas between neighbours pack narrower, as in sorted runs, the block
+ * stores the deltas instead, less the smallest one. Values go round-robin to
+ * eight 32-bit lanes, so one AVX2 shift and mask unpacks eight consecutive
+ * values whatever the width, and delta blocks are rebuilt with an in-register
+ * prefix sum. Blocks whose range does not fit 32 bits are kept raw.
+ *
+ * Scans work block by block: the header alone settles blocks that match
+ * entirely or not at all, and the rest are compared as 32-bit offsets
+ * without widening back to long. The pack is a read-optimised copy of the
+ * column; updates still write the plain column and the pack is rebuilt.
+ */
+#include "log_store.h"
+#include <immintrin.h>
+
+enum
+{
+    PACK_FOR, PACK_DELTA, PACK_RAW
+};
+
+static void* pack_alloc(size_t bytes)
+{
+    void* p = aligned_alloc(LOG_ALIGN, (bytes + LOG_ALIGN - 1) / LOG_ALIGN * LOG_ALIGN);
+    if (!p)
+    {
+        printf("log pack: out of memory (%zu bytes)\n", bytes);
+        exit(-1);
+    }
+    return p;
+}
+
+static int width(uint32_t x)
+{
+    return x ? 32 - __builtin_clz(x) : 0;
+}
+
+/* 32-bit words of a block packed at bits per value: 8 lanes of 16 values */
+static size_t block_words(int bits)
+{
+    return bits == 64 ? 2 * LOG_PACK_ROWS : 8 * (size_t)((bits + 1) / 2);
+}
+
+/* value i goes to lane i % 8, at bit (i / 8) * bits of that lane */
+static void pack_lanes(uint32_t* out, const uint32_t* v, int bits)
+{
+    int i;
+    memset(out, 0, block_words(bits) * sizeof(uint32_t));
+    for (i = 0; i < LOG_PACK_ROWS && bits; i++)
+    {
+        int lane = i % 8, bit = i / 8 * bits, s = bit % 32;
+        uint32_t* w = out + bit / 32 * 8 + lane;
+        w[0] |= v[i] << s;
+        if (s + bits > 32)
+            w[8] |= v[i] >> (32 - s);
+    }
+}
+
+void log_time_pack(LogTimePack* p, const long* values, size_t rows)
+{
+    size_t b, words = 0;
+    uint32_t o[LOG_PACK_ROWS], d[LOG_PACK_ROWS];
+    int i;
+
+    memset(p, 0, sizeof(*p));
+    p->rows = rows;
+    p->blocks = (rows + LOG_PACK_ROWS - 1) / LOG_PACK_ROWS;
+    p->block = pack_alloc((p->blocks ? p->blocks : 1) * sizeof(LogPackBlock));
+    /* sized for the worst case, then shrunk to fit */
+    p->data = pack_alloc((p->blocks ? p->blocks : 1) * block_words(64) * sizeof(uint32_t));
+
+    for (b = 0; b < p->blocks; b++)
+    {
+        LogPackBlock* h = &p->block[b];
+        const long* v = values + b * LOG_PACK_ROWS;
+        int n = rows - b * LOG_PACK_ROWS < LOG_PACK_ROWS ? rows - b * LOG_PACK_ROWS : LOG_PACK_ROWS;
+        h->min = h->max = v[0];
+        for (i = 1; i < n; i++)
+        {
+            if (v[i] < h->min) h->min = v[i];
+            if (v[i] > h->max) h->max = v[i];
+        }
+        h->offset = words;
+        if ((unsigned long)(h->max - h->min) > 0xffffffffUL)
+        {
+            h->mode = PACK_RAW;
+            h->bits = 64;
+            memset(p->data + words, 0, block_words(64) * sizeof(uint32_t));
+            memcpy(p->data + words, v, n * sizeof(long));
+            words += block_words(64);
+            continue;
+        }
+
+        /* offsets from the min; the tail of a short block repeats the min */
+        uint32_t omax = 0, dmin = 0, dspan = 0;
+        for (i = 0; i < LOG_PACK_ROWS; i++)
+        {
+            o[i] = i < n ? (uint32_t)(v[i] - h->min) : 0;
+            if (o[i] > omax) omax = o[i];
+        }
+        /* deltas, taken mod 2^32 and rebased on the smallest as a signed value */
+        for (i = 1; i < LOG_PACK_ROWS; i++)
+        {
+            int32_t di = (int32_t)(o[i] - o[i - 1]);
+            if (i == 1 || di < (int32_t)dmin) dmin = (uint32_t)di;
+        }
+        for (i = 1; i < LOG_PACK_ROWS; i++)
+        {
+            uint32_t s = o[i] - o[i - 1] - dmin;
+            d[i] = s;
+            if (s > dspan) dspan = s;
+        }
+        d[0] = 0;
+
+        /* prefix sums of delta blocks are taken in 32 bits, so keep 128 deltas below 2^32 */
+        if (width(dspan) < width(omax) && width(dspan) <= 24)
+        {
+            h->mode = PACK_DELTA;
+            h->bits = width(dspan);
+            h->start = o[0];
+            h->step = dmin;
+            pack_lanes(p->data + words, d, h->bits);
+        }
+        else
+        {
+            h->mode = PACK_FOR;
+            h->bits = width(omax);
+            pack_lanes(p->data + words, o, h->bits);
+        }
+        words += block_words(h->bits);
+    }
+
+    p->words = words;
+    uint32_t* fit = pack_alloc((words ? words : 1) * sizeof(uint32_t));
+    memcpy(fit, p->data, words * sizeof(uint32_t));
+    free(p->data);
+    p->data = fit;
+}
+
+void log_time_pack_free(LogTimePack* p)
+{
+    free(p->block);
+    free(p->data);
+    memset(p, 0, sizeof(*p));
+}
+
+size_t log_time_pack_bytes(const LogTimePack* p)
+{
+    return p->blocks * sizeof(LogPackBlock) + p->words * sizeof(uint32_t);
+}
+
+/* the block's values as offsets from its min (not for raw blocks) */
+static inline void unpack_offsets(const LogTimePack* p, const LogPackBlock* h, uint32_t* out)
+{
+    const uint32_t* data = p->data + h->offset;
+    int bits = h->bits, k;
+    __m256i mask = _mm256_set1_epi32(bits == 32 ? -1 : (int)((1u << bits) - 1));
+    __m256i carry = _mm256_set1_epi32((int)h->start);
+    __m256i step = _mm256_set1_epi32((int)h->step);
+    __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (k = 0; k < LOG_PACK_ROWS / 8; k++)
+    {
+        int bit = k * bits, s = bit % 32;
+        const __m256i* w = (const __m256i*)(data + bit / 32 * 8);
+        __m256i x = _mm256_setzero_si256();
+        if (bits)
+        {
+            x = _mm256_srl_epi32(_mm256_load_si256(w), _mm_cvtsi32_si128(s));
+            if (s + bits > 32)
+                x = _mm256_or_si256(x, _mm256_sll_epi32(_mm256_load_si256(w + 1), _mm_cvtsi32_si128(32 - s)));
+            x = _mm256_and_si256(x, mask);
+        }
+        if (h->mode == PACK_DELTA)
+        {
+            /* value i = start + sum of packed deltas up to i + i * step */
+            x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+            x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+            x = _mm256_add_epi32(x, _mm256_blend_epi32(_mm256_setzero_si256(),
+                                 _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(3)), 0xf0));
+            x = _mm256_add_epi32(x, carry);
+            carry = _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(7));
+            __m256i idx = _mm256_add_epi32(lane, _mm256_set1_epi32(8 * k));
+            _mm256_storeu_si256((__m256i*)(out + 8 * k), _mm256_add_epi32(x, _mm256_mullo_epi32(idx, step)));
+        }
+        else
+        {
+            _mm256_storeu_si256((__m256i*)(out + 8 * k), x);
+        }
+    }
+}
+
+void log_time_unpack(const LogTimePack* p, size_t block, long* out)
+{
+    const LogPackBlock* h = &p->block[block];
+    uint32_t o[LOG_PACK_ROWS];
+    int k;
+    if (h->mode == PACK_RAW)
+    {
+        memcpy(out, p->data + h->offset, LOG_PACK_ROWS * sizeof(long));
+        return;
+    }
+    unpack_offsets(p, h, o);
+    __m256i base = _mm256_set1_epi64x(h->min);
+    for (k = 0; k < LOG_PACK_ROWS; k += 4)
+    {
+        __m256i x = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(o + k)));
+        _mm256_storeu_si256((__m256i*)(out + k), _mm256_add_epi64(x, base));
+    }
+}
+
+/* 1 when every value of [min, max] satisfies op value, 0 when none does, -1 when it depends */
+static int block_verdict(long min, long max, LogOp op, long v)
+{
+    switch (op)
+    {
+    case LOG_EQ: return v < min || v > max ? 0 : min == max ? 1 : -1;
+    case LOG_NE: return v < min || v > max ? 1 : min == max ? 0 : -1;
+    case LOG_LT: return max < v ? 1 : min >= v ? 0 : -1;
+    case LOG_LE: return max <= v ? 1 : min > v ? 0 : -1;
+    case LOG_GT: return min > v ? 1 : max <= v ? 0 : -1;
+    default:     return min >= v ? 1 : max < v ? 0 : -1;
+    }
+}
+
+/* unsigned 32-bit compare as a signed one with the sign bits flipped */
+static inline __m256i cmpu32(__m256i x, __m256i v, LogOp op)
+{
+    const __m256i sign = _mm256_set1_epi32((int)0x80000000u), ones = _mm256_set1_epi32(-1);
+    x = _mm256_xor_si256(x, sign);
+    v = _mm256_xor_si256(v, sign);
+    switch (op)
+    {
+    case LOG_EQ: return _mm256_cmpeq_epi32(x, v);
+    case LOG_NE: return _mm256_xor_si256(_mm256_cmpeq_epi32(x, v), ones);
+    case LOG_LT: return _mm256_cmpgt_epi32(v, x);
+    case LOG_LE: return _mm256_xor_si256(_mm256_cmpgt_epi32(x, v), ones);
+    case LOG_GT: return _mm256_cmpgt_epi32(x, v);
+    default:     return _mm256_xor_si256(_mm256_cmpgt_epi32(v, x), ones);
+    }
+}
+
+/* rows of block b where op v holds, as two bitmap words */
+static void block_select(const LogTimePack* p, size_t b, LogOp op, long v, uint64_t* m, size_t* decoded)
+{
+    const LogPackBlock* h = &p->block[b];
+    int k, verdict = block_verdict(h->min, h->max, op, v);
+    m[0] = m[1] = verdict == 1 ? ~0ULL : 0;
+    if (verdict >= 0)
+    {
+        return;
+    }
+    (*decoded)++;
+    if (h->mode == PACK_RAW)
+    {
+        const long* x = (const long*)(p->data + h->offset);
+        for (k = 0; k < LOG_PACK_ROWS; k++)
+        {
+            long t = x[k];
+            int hit = op == LOG_EQ ? t == v : op == LOG_NE ? t != v : op == LOG_LT ? t < v
+                    : op == LOG_LE ? t <= v : op == LOG_GT ? t > v : t >= v;
+            m[k / 64] |= (uint64_t)hit << (k % 64);
+        }
+        return;
+    }
+    /* min <= v <= max here, so v fits the block's offsets */
+    uint32_t o[LOG_PACK_ROWS];
+    unpack_offsets(p, h, o);
+    __m256i c = _mm256_set1_epi32((int)(uint32_t)(v - h->min));
+    for (k = 0; k < LOG_PACK_ROWS; k += 8)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(o + k));
+        m[k / 64] |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(cmpu32(x, c, op))) << (k % 64);
+    }
+}
+
+size_t log_time_select(const LogTimePack* p, LogOp op, long value, uint64_t* mask, int threads, size_t* decoded)
+{
+    size_t matched = 0, unpacked = 0;
+    long b, blocks = p->blocks;
+    if (threads <= 0)
+    {
+        threads = log_max_threads();
+    }
+#pragma omp parallel for num_threads(threads) schedule(static) reduction(+ : matched, unpacked)
+    for (b = 0; b < blocks; b++)
+    {
+        uint64_t m[2];
+        size_t tail = p->rows - b * LOG_PACK_ROWS;
+        block_select(p, b, op, value, m, &unpacked);
+        /* rows past the end are padding */
+        if (tail < 64)
+        {
+            m[0] &= ~0ULL >> (64 - tail);
+            m[1] = 0;
+        }
+        else if (tail < LOG_PACK_ROWS)
+        {
+            m[1] &= tail == 64 ? 0 : ~0ULL >> (128 - tail);
+        }
+        matched += __builtin_popcountll(m[0]) + __builtin_popcountll(m[1]);
+        if (mask)
+        {
+            mask[2 * b] = m[0];
+            mask[2 * b + 1] = m[1];
+        }
+    }
+    if (decoded)
+    {
+        *decoded = unpacked;
+    }
+    return matched;
+}
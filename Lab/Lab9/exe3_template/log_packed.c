@@ -0,0 +1,138 @@
+/**
+ * Checks and times the block-compressed reference_time column: round trips
+ * for nearly sorted traffic times, the evenly spaced times of log_base and
+ * random times that need raw blocks, selections against the plain column for
+ * every operator, then compression ratio, decode speed and time-window scans
+ * on the packed column against the same scans on the plain one.
+ *
+ * Usage: ./log_packed [rows]
+ */
+#include "log_store.h"
+
+static void check_pack(const long* values, size_t rows, const char* name)
+{
+    LogTimePack p;
+    long out[LOG_PACK_ROWS];
+    size_t b, i, modes[3] = {0, 0, 0};
+    uint64_t* mask = malloc(((rows + 127) / 128 * 2 + 1) * sizeof(uint64_t));
+    int op;
+
+    log_time_pack(&p, values, rows);
+    for (b = 0; b < p.blocks; b++)
+    {
+        log_time_unpack(&p, b, out);
+        for (i = 0; i < LOG_PACK_ROWS && b * LOG_PACK_ROWS + i < rows; i++)
+            log_check(out[i] == values[b * LOG_PACK_ROWS + i], "unpacked value");
+        modes[p.block[b].mode]++;
+    }
+
+    /* probes on, between and outside the stored values */
+    long probe[5] = {values[rows / 2], values[rows / 3] + 1, values[0] - 1, values[rows - 1], values[rows / 7]};
+    for (op = LOG_EQ; op <= LOG_GE; op++)
+    for (i = 0; i < 5; i++)
+    {
+        size_t r, expect = 0;
+        size_t got = log_time_select(&p, op, probe[i], mask, 0, NULL);
+        for (r = 0; r < rows; r++)
+        {
+            long t = values[r];
+            int hit = op == LOG_EQ ? t == probe[i] : op == LOG_NE ? t != probe[i] : op == LOG_LT ? t < probe[i]
+                    : op == LOG_LE ? t <= probe[i] : op == LOG_GT ? t > probe[i] : t >= probe[i];
+            expect += hit;
+            log_check((int)((mask[r / 64] >> (r % 64)) & 1) == hit, "selected row");
+        }
+        log_check(got == expect, "selected count");
+    }
+    printf("%-8s %zu rows: %zu bytes packed, %.1fx smaller (%zu FOR, %zu delta, %zu raw blocks)\n", name, rows,
+           log_time_pack_bytes(&p), (double)rows * sizeof(long) / log_time_pack_bytes(&p), modes[0], modes[1], modes[2]);
+    log_time_pack_free(&p);
+    free(mask);
+}
+
+/* rows where lo <= reference_time < hi, on the plain column */
+static size_t plain_window(LogStore* s, long lo, long hi)
+{
+    LogPred ge = {LOG_COL_REFERENCE_TIME, LOG_GE, lo}, lt = {LOG_COL_REFERENCE_TIME, LOG_LT, hi};
+    size_t base, n = 0;
+    for (base = 0; base < s->rows; base += 64)
+    {
+        uint64_t m = log_pred_mask(s, ge, base) & log_pred_mask(s, lt, base);
+        if (s->rows - base < 64)
+            m &= ~0ULL >> (64 - (s->rows - base));
+        n += __builtin_popcountll(m);
+    }
+    return n;
+}
+
+/* the same on the packed column: two selections and an AND of the masks */
+static size_t packed_window(const LogTimePack* p, long lo, long hi, uint64_t* a, uint64_t* b, size_t* decoded)
+{
+    size_t i, n = 0, d1, d2;
+    log_time_select(p, LOG_GE, lo, a, 1, &d1);
+    log_time_select(p, LOG_LT, hi, b, 1, &d2);
+    for (i = 0; i < 2 * p->blocks; i++)
+        n += __builtin_popcountll(a[i] & b[i]);
+    *decoded = d1 + d2;
+    return n;
+}
+
+int main(int argc, char** argv)
+{
+    size_t rows = argc > 1 ? (size_t)atol(argv[1]) : NUM_ENTRIES, i;
+    LogStore s;
+    LogTimePack p;
+    int k;
+    if (rows < 8)
+    {
+        rows = 8;
+    }
+
+    log_store_init(&s, rows);
+    log_make_traffic(&s, rows, 1);
+    check_pack(s.reference_time, rows, "traffic");
+
+    long* other = malloc(rows * sizeof(long));
+    for (i = 0; i < rows; i++)
+        other[i] = i * 123;
+    check_pack(other, rows, "log_base");
+    srand(1);
+    for (i = 0; i < rows; i++)
+        other[i] = ((long)rand() << 31 | rand()) - (1L << 60);
+    check_pack(other, rows, "random");
+    free(other);
+
+    /* decode speed */
+    long out[LOG_PACK_ROWS];
+    log_time_pack(&p, s.reference_time, rows);
+    double t0 = log_now();
+    for (k = 0; k < 10; k++)
+        for (i = 0; i < p.blocks; i++)
+            log_time_unpack(&p, i, out);
+    double t = (log_now() - t0) / 10;
+    printf("unpack %f s, %.0f M values/s\n", t, rows / t / 1e6);
+
+    /* windows of 1%, 10% and 50% of the time span */
+    uint64_t* a = malloc(2 * p.blocks * sizeof(uint64_t));
+    uint64_t* b = malloc(2 * p.blocks * sizeof(uint64_t));
+    long first = s.reference_time[0], span = s.reference_time[rows - 1] - first;
+    int pct[3] = {1, 10, 50};
+    for (k = 0; k < 3; k++)
+    {
+        long lo = first + span / 3, hi = lo + span * pct[k] / 100;
+        size_t decoded, n = plain_window(&s, lo, hi);
+        log_check(packed_window(&p, lo, hi, a, b, &decoded) == n, "packed window");
+        int r;
+        double t1 = log_now();
+        for (r = 0; r < 10; r++) plain_window(&s, lo, hi);
+        double t2 = log_now();
+        for (r = 0; r < 10; r++) packed_window(&p, lo, hi, a, b, &decoded);
+        double t3 = log_now();
+        printf("%2d%% window: %zu rows, plain %f s, packed %f s (%zu of %zu blocks unpacked)\n", pct[k], n,
+               (t2 - t1) / 10, (t3 - t2) / 10, decoded, 2 * p.blocks);
+    }
+    free(a);
+    free(b);
+    log_time_pack_free(&p);
+    log_store_free(&s);
+    return 0;
+}
@@ -0,0 +1,327 @@
+/**
+ * Ingestion of web access logs in the combined format:
+ *   10.0.1.2 - frank [10/Oct/2000:13:55:36 -0700] "GET /a.gif HTTP/1.0" 200 2326 "referer" "user agent"
+ * src_ip is the dotted quad packed into an int, reference_time the request
+ * time in Unix seconds, URL the request path, bro the user agent and status
+ * the response code. The input (a buffer or an mmapped file) is cut into one
+ * chunk per thread at line boundaries. Threads find newlines and field
+ * delimiters 32 bytes at a time with AVX2 compares and parse into private
+ * batches that only point into the input; the batches are then appended in
+ * input order, which is the one serial step because the dictionaries are
+ * shared.
+ */
+#include "log_store.h"
+#include <immintrin.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* one parsed line; the strings point into the input */
+typedef struct Parsed
+{
+    int src_ip, status;
+    long reference_time;
+    const char* url;
+    const char* bro;
+    unsigned int url_len, bro_len;
+} Parsed;
+
+typedef struct Batch
+{
+    Parsed* rows;
+    size_t count, cap, bad;
+} Batch;
+
+/* first c in [p, end), or end */
+static inline const char* find_byte(const char* p, const char* end, char c)
+{
+    __m256i v = _mm256_set1_epi8(c);
+    for (; p + 32 <= end; p += 32)
+    {
+        unsigned int m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), v));
+        if (m)
+        {
+            return p + __builtin_ctz(m);
+        }
+    }
+    while (p < end && *p != c)
+    {
+        p++;
+    }
+    return p;
+}
+
+/* last c in [begin, end), or NULL */
+static inline const char* find_byte_rev(const char* begin, const char* end, char c)
+{
+    __m256i v = _mm256_set1_epi8(c);
+    for (; end - begin >= 32; end -= 32)
+    {
+        unsigned int m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(end - 32)), v));
+        if (m)
+        {
+            return end - 1 - __builtin_clz(m);
+        }
+    }
+    while (end > begin)
+    {
+        if (*--end == c)
+        {
+            return end;
+        }
+    }
+    return NULL;
+}
+
+/* the n decimal digits at p; -1 if any of them is not a digit */
+static inline int digits(const char* p, int n)
+{
+    int v = 0;
+    while (n--)
+    {
+        unsigned int d = (unsigned char)*p++ - '0';
+        if (d > 9)
+        {
+            return -1;
+        }
+        v = v * 10 + d;
+    }
+    return v;
+}
+
+/* days since 1970-01-01 of a civil date (proleptic Gregorian) */
+static long days_from_civil(long y, int m, int d)
+{
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/* "10/Oct/2000:13:55:36 -0700" at p, 26 bytes; -1 if malformed */
+static long parse_time(const char* p)
+{
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    int m;
+    for (m = 0; m < 12; m++)
+    {
+        if (memcmp(p + 3, months + 3 * m, 3) == 0)
+        {
+            break;
+        }
+    }
+    if (m == 12 || p[2] != '/' || p[6] != '/' || p[11] != ':' || p[14] != ':' || p[17] != ':' || p[20] != ' '
+        || (p[21] != '+' && p[21] != '-'))
+    {
+        return -1;
+    }
+    int day = digits(p, 2), year = digits(p + 7, 4);
+    int hour = digits(p + 12, 2), min = digits(p + 15, 2), sec = digits(p + 18, 2);
+    int tz_hour = digits(p + 22, 2), tz_min = digits(p + 24, 2);
+    if ((day | year | hour | min | sec | tz_hour | tz_min) < 0)
+    {
+        return -1;
+    }
+    long t = days_from_civil(year, m + 1, day) * 86400 + hour * 3600 + min * 60 + sec;
+    long tz = tz_hour * 3600 + tz_min * 60;
+    return p[21] == '-' ? t + tz : t - tz;
+}
+
+/* parses [p, eol) into r; 0 if the line is not in combined format */
+static int parse_line(const char* p, const char* eol, Parsed* r)
+{
+    unsigned int ip = 0, part = 0;
+    int dots = 0, len = 0;
+    const char* q = p;
+
+    /* four octets of one to three digits, each at most 255 */
+    for (; q < eol && *q != ' '; q++)
+    {
+        if (*q == '.')
+        {
+            if (len == 0 || part > 255)
+            {
+                return 0;
+            }
+            ip = ip << 8 | part;
+            part = 0;
+            len = 0;
+            dots++;
+        }
+        else if (*q >= '0' && *q <= '9' && len < 3)
+        {
+            part = part * 10 + (*q - '0');
+            len++;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    if (dots != 3 || len == 0 || part > 255)
+    {
+        return 0;
+    }
+    r->src_ip = (int)(ip << 8 | part);
+
+    q = find_byte(q, eol, '[');
+    if (eol - q < 28 || q[27] != ']' || (r->reference_time = parse_time(q + 1)) < 0)
+    {
+        return 0;
+    }
+
+    /* "METHOD URL PROTOCOL" */
+    const char* req = find_byte(q + 28, eol, '"');
+    const char* req_end = find_byte(req + 1, eol, '"');
+    if (req_end >= eol)
+    {
+        return 0;
+    }
+    const char* url = find_byte(req + 1, req_end, ' ');
+    url = url < req_end ? url + 1 : req_end;
+    r->url = url;
+    r->url_len = find_byte(url, req_end, ' ') - url;
+
+    q = req_end + 1;
+    while (q < eol && *q == ' ')
+    {
+        q++;
+    }
+    r->status = 0;
+    for (; q < eol && *q >= '0' && *q <= '9'; q++)
+    {
+        r->status = r->status * 10 + (*q - '0');
+    }
+
+    /* the user agent is the last quoted field */
+    const char* ua_end = find_byte_rev(req_end + 1, eol, '"');
+    const char* ua = ua_end ? find_byte_rev(req_end + 1, ua_end, '"') : NULL;
+    if (!ua)
+    {
+        return 0;
+    }
+    r->bro = ua + 1;
+    r->bro_len = ua_end - ua - 1;
+    return 1;
+}
+
+static void parse_chunk(const char* p, const char* end, Batch* b)
+{
+    while (p < end)
+    {
+        const char* eol = find_byte(p, end, '\n');
+        const char* line_end = eol > p && eol[-1] == '\r' ? eol - 1 : eol;
+        if (line_end > p)
+        {
+            if (b->count == b->cap)
+            {
+                b->cap = b->cap ? b->cap * 2 : 4096;
+                b->rows = realloc(b->rows, b->cap * sizeof(Parsed));
+                if (!b->rows)
+                {
+                    printf("log ingest: out of memory\n");
+                    exit(-1);
+                }
+            }
+            if (parse_line(p, line_end, &b->rows[b->count]))
+                b->count++;
+            else
+                b->bad++;
+        }
+        p = eol + 1;
+    }
+}
+
+size_t log_ingest_buffer(LogStore* s, const char* buf, size_t len, int threads, LogIngestStats* st)
+{
+    LogIngestStats local;
+    int t;
+    size_t i, rows = 0;
+    if (!st)
+    {
+        st = &local;
+    }
+    memset(st, 0, sizeof(*st));
+    if (threads <= 0)
+    {
+        threads = log_max_threads();
+    }
+    /* chunks under a few lines are not worth a thread */
+    if ((size_t)threads > len / 4096 + 1)
+    {
+        threads = len / 4096 + 1;
+    }
+
+    Batch* batches = calloc(threads, sizeof(Batch));
+    double t0 = log_now();
+#pragma omp parallel for num_threads(threads) schedule(static, 1)
+    for (t = 0; t < threads; t++)
+    {
+        /* each chunk starts after the first newline at or past its nominal start */
+        const char* begin = buf + len * t / threads;
+        const char* end = buf + len * (t + 1) / threads;
+        if (t > 0)
+            begin = find_byte(begin - 1, buf + len, '\n') + 1;
+        if (t < threads - 1)
+            end = find_byte(end - 1, buf + len, '\n') + 1;
+        if (end > buf + len)
+            end = buf + len;
+        if (begin < end)
+            parse_chunk(begin, end, &batches[t]);
+    }
+    double t1 = log_now();
+
+    for (t = 0; t < threads; t++)
+    {
+        Batch* b = &batches[t];
+        for (i = 0; i < b->count; i++)
+        {
+            Parsed* r = &b->rows[i];
+            log_store_append_fields(s, r->src_ip, r->url, r->url_len, r->reference_time, r->bro, r->bro_len, r->status);
+        }
+        rows += b->count;
+        st->bad += b->bad;
+        free(b->rows);
+    }
+    free(batches);
+
+    st->rows = rows;
+    st->bytes = len;
+    st->parse_s = t1 - t0;
+    st->append_s = log_now() - t1;
+    return rows;
+}
+
+size_t log_ingest_file(LogStore* s, const char* path, int threads, LogIngestStats* st)
+{
+    struct stat sb;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &sb) != 0)
+    {
+        printf("cannot open %s\n", path);
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    if (sb.st_size == 0)
+    {
+        close(fd);
+        return log_ingest_buffer(s, "", 0, threads, st);
+    }
+    const char* buf = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED)
+    {
+        printf("cannot map %s\n", path);
+        return 0;
+    }
+    madvise((void*)buf, sb.st_size, MADV_SEQUENTIAL);
+    size_t rows = log_ingest_buffer(s, buf, sb.st_size, threads, st);
+    munmap((void*)buf, sb.st_size);
+    return rows;
+}
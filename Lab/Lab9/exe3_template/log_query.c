@@ -0,0 +1,289 @@
+/**
+ * Aggregation queries over the log store: filter, project, group by and
+ * aggregate in a single pass. Each 64-row block is filtered into a row mask
+ * with the same AVX2 compares as updates, only the group and value columns of
+ * the matching rows are read, and each row is folded into a thread-local
+ * open-addressing hash table (linear probing, load factor at most 1/2) keyed
+ * by the group column. Threads work on the partitioned scan executor and
+ * never share a table; the tables are merged at the end, which costs one
+ * probe per group rather than per row. Sorting the groups is left to callers
+ * that need it: for tens of thousands of groups it costs as much as the scan.
+ * Predicates on reference_time bound the query to a time window, and blocks
+ * whose zone map misses the window are skipped before any column is read.
+ */
+#include "log_store.h"
+#include <limits.h>
+
+#define AGG_MIN_SLOTS 64
+
+/*
+ * One thread's groups, laid out like a string dictionary: the groups sit
+ * densely in insertion order and the open-addressing slots hold index + 1
+ * (0 is empty). The slots stay small enough to be cached for tens of
+ * thousands of groups, rehashing only rebuilds them, and the group array is
+ * already the result. Padded so neighbouring tables never share a line.
+ */
+typedef struct AggTable
+{
+    LogGroup* groups;
+    size_t used, cap;
+    uint32_t* slots;
+    size_t mask;
+    char pad[LOG_ALIGN - sizeof(LogGroup*) - sizeof(uint32_t*) - 3 * sizeof(size_t)];
+} AggTable;
+
+static inline size_t key_hash(long key)
+{
+    uint64_t h = (uint64_t)key * 0x9e3779b97f4a7c15ull;
+    return (size_t)(h ^ h >> 29);
+}
+
+static void* agg_alloc(void* p, size_t bytes)
+{
+    p = realloc(p, bytes);
+    if (!p)
+    {
+        printf("log query: out of memory\n");
+        exit(-1);
+    }
+    return p;
+}
+
+static void agg_init(AggTable* t)
+{
+    t->cap = AGG_MIN_SLOTS / 2;
+    t->used = 0;
+    t->groups = agg_alloc(NULL, t->cap * sizeof(LogGroup));
+    t->mask = AGG_MIN_SLOTS - 1;
+    t->slots = calloc(AGG_MIN_SLOTS, sizeof(uint32_t));
+}
+
+/* slot holding key, or the empty slot where it would go */
+static inline uint32_t* agg_probe(const AggTable* t, long key)
+{
+    size_t i = key_hash(key) & t->mask;
+    while (t->slots[i] && t->groups[t->slots[i] - 1].key != key)
+    {
+        i = (i + 1) & t->mask;
+    }
+    return &t->slots[i];
+}
+
+static void agg_rehash(AggTable* t)
+{
+    size_t g, n = (t->mask + 1) * 2;
+    free(t->slots);
+    t->slots = calloc(n, sizeof(uint32_t));
+    t->mask = n - 1;
+    t->cap = n / 2;
+    t->groups = agg_alloc(t->groups, t->cap * sizeof(LogGroup));
+    if (!t->slots)
+    {
+        printf("log query: out of memory\n");
+        exit(-1);
+    }
+    for (g = 0; g < t->used; g++)
+    {
+        *agg_probe(t, t->groups[g].key) = g + 1;
+    }
+}
+
+/* the group of key, created empty if it is new */
+static inline LogGroup* agg_group(AggTable* t, long key)
+{
+    uint32_t* slot = agg_probe(t, key);
+    if (!*slot)
+    {
+        if (t->used == t->cap)
+        {
+            agg_rehash(t);
+            slot = agg_probe(t, key);
+        }
+        LogGroup* g = &t->groups[t->used];
+        *slot = ++t->used;
+        g->key = key;
+        g->count = 0;
+        g->sum = 0;
+        g->min = (long)(~0UL >> 1);
+        g->max = -g->min - 1;
+        return g;
+    }
+    return &t->groups[*slot - 1];
+}
+
+static inline void agg_add(LogGroup* g, long v)
+{
+    g->count++;
+    g->sum += v;
+    if (v < g->min) g->min = v;
+    if (v > g->max) g->max = v;
+}
+
+static void agg_merge(AggTable* into, const AggTable* t)
+{
+    size_t i;
+    for (i = 0; i < t->used; i++)
+    {
+        const LogGroup* s = &t->groups[i];
+        LogGroup* g = agg_group(into, s->key);
+        g->count += s->count;
+        g->sum += s->sum;
+        if (s->min < g->min) g->min = s->min;
+        if (s->max > g->max) g->max = s->max;
+    }
+}
+
+/* a projected column: exactly one of the pointers is set, or neither for LOG_COL_NONE */
+typedef struct Projection
+{
+    const int* i32;
+    const long* i64;
+} Projection;
+
+static Projection project(const LogStore* s, LogColumn col)
+{
+    Projection p = {NULL, NULL};
+    if (col == LOG_COL_REFERENCE_TIME)
+        p.i64 = s->reference_time;
+    else if (col != LOG_COL_NONE)
+        p.i32 = log_int_column(s, col);
+    return p;
+}
+
+static inline long projected(Projection p, size_t row)
+{
+    return p.i64 ? p.i64[row] : p.i32 ? p.i32[row] : 0;
+}
+
+typedef struct Query
+{
+    const LogQuery* q;
+    Projection key, value;
+    AggTable* tables;
+    size_t matched;
+    long lo, hi;                /* time window implied by the predicates, inclusive */
+    size_t first;               /* first row that can fall in it */
+} Query;
+
+/* narrows [lo, hi] to the times a reference_time predicate admits; only used to skip blocks */
+static void time_window(LogPred p, long* lo, long* hi)
+{
+    long a = LONG_MIN, b = LONG_MAX;
+    if (p.col != LOG_COL_REFERENCE_TIME)
+        return;
+    switch (p.op)
+    {
+    case LOG_EQ: a = b = p.value; break;
+    case LOG_LT: b = p.value == LONG_MIN ? p.value : p.value - 1; break;
+    case LOG_LE: b = p.value; break;
+    case LOG_GT: a = p.value == LONG_MAX ? p.value : p.value + 1; break;
+    case LOG_GE: a = p.value; break;
+    default: break;
+    }
+    if (a > *lo) *lo = a;
+    if (b < *hi) *hi = b;
+}
+
+static void query_range(LogStore* s, size_t begin, size_t end, int tid, void* ctx)
+{
+    Query* u = ctx;
+    const LogQuery* q = u->q;
+    AggTable* t = &u->tables[tid];
+    size_t base, row[64], matched = 0;
+    long key[64];
+    int j, k, n;
+
+    agg_init(t);
+    for (base = begin > u->first ? begin : u->first; base < end; base += 64)
+    {
+        if (s->zone_max[base / 64] < u->lo || s->zone_min[base / 64] > u->hi)
+        {
+            continue;
+        }
+        uint64_t m = end - base < 64 ? ~0ULL >> (64 - (end - base)) : ~0ULL;
+        for (j = 0; j < q->npreds && m; j++)
+        {
+            m &= log_pred_mask(s, q->where[j], base);
+        }
+        matched += __builtin_popcountll(m);
+        /* gather the block's keys and prefetch their slots first, so that misses overlap */
+        for (n = 0; m; m &= m - 1, n++)
+        {
+            row[n] = base + __builtin_ctzll(m);
+            key[n] = projected(u->key, row[n]);
+            __builtin_prefetch(&t->slots[key_hash(key[n]) & t->mask]);
+        }
+        for (k = 0; k < n; k++)
+        {
+            agg_add(agg_group(t, key[k]), projected(u->value, row[k]));
+        }
+    }
+#pragma omp atomic
+    u->matched += matched;
+}
+
+static int key_order(const void* a, const void* b)
+{
+    long x = ((const LogGroup*)a)->key, y = ((const LogGroup*)b)->key;
+    return (x > y) - (x < y);
+}
+
+size_t log_query(LogStore* s, const LogQuery* q, LogGroups* out)
+{
+    int threads = s->threads > 0 ? s->threads : log_max_threads();
+    int i;
+    if (q->npreds > LOG_MAX_PREDS)
+    {
+        printf("log_query: at most %d predicates per query\n", LOG_MAX_PREDS);
+        exit(-1);
+    }
+
+    Query u = {q, project(s, q->group), project(s, q->value), calloc(threads, sizeof(AggTable)), 0,
+               LONG_MIN, LONG_MAX, 0};
+    for (i = 0; i < q->npreds; i++)
+    {
+        time_window(q->where[i], &u.lo, &u.hi);
+    }
+    u.first = log_zone_first(s, u.lo) * 64;
+    log_scan_parallel(s, query_range, &u, threads);
+
+    /* merge into the largest table; workers the executor did not start left theirs empty */
+    AggTable* into = &u.tables[0];
+    for (i = 1; i < threads; i++)
+        if (u.tables[i].used > into->used) into = &u.tables[i];
+    if (!into->groups)
+        agg_init(into);
+    for (i = 0; i < threads; i++)
+    {
+        if (&u.tables[i] == into) continue;
+        if (u.tables[i].groups)
+            agg_merge(into, &u.tables[i]);
+        free(u.tables[i].groups);
+        free(u.tables[i].slots);
+    }
+
+    out->groups = into->groups;
+    out->count = into->used;
+    free(into->slots);
+    free(u.tables);
+    return u.matched;
+}
+
+void log_groups_sort(LogGroups* g)
+{
+    qsort(g->groups, g->count, sizeof(LogGroup), key_order);
+}
+
+void log_groups_free(LogGroups* g)
+{
+    free(g->groups);
+    g->groups = NULL;
+    g->count = 0;
+}
+
+const LogGroup* log_groups_find(const LogGroups* g, long key)
+{
+    LogGroup k;
+    k.key = key;
+    return bsearch(&k, g->groups, g->count, sizeof(LogGroup), key_order);
+}
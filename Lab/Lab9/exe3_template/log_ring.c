@@ -0,0 +1,96 @@
+/**
+ * Bounded ring that takes events from many ingest threads and hands them to
+ * the one thread that appends to the store (the dictionaries and the bitmap
+ * are not safe to grow concurrently, so appends stay single-writer).
+ *
+ * A producer claims a position with one atomic fetch-add on head, so
+ * producers never retry against each other. Each slot carries a sequence
+ * number: it equals the position while the slot is free for that lap, and
+ * the producer stores position + 1 with release order once the event is
+ * written. The consumer reads the sequence with acquire order, appends the
+ * event and frees the slot for the next lap by storing position + capacity.
+ * A producer that claims a slot the consumer has not freed yet waits on that
+ * slot alone. head and tail sit on their own cache lines, as does every slot.
+ */
+#include "log_store.h"
+#include <immintrin.h>
+#include <sched.h>
+
+void log_ring_init(LogRing* r, size_t capacity)
+{
+    size_t i, n = 2;
+    while (n < capacity)
+    {
+        n *= 2;
+    }
+    r->slots = aligned_alloc(LOG_ALIGN, n * sizeof(LogRingSlot));
+    if (!r->slots)
+    {
+        printf("log ring: out of memory (%zu slots)\n", n);
+        exit(-1);
+    }
+    for (i = 0; i < n; i++)
+    {
+        atomic_init(&r->slots[i].seq, i);
+    }
+    r->mask = n - 1;
+    atomic_init(&r->head, 0);
+    r->tail = 0;
+}
+
+void log_ring_free(LogRing* r)
+{
+    free(r->slots);
+    r->slots = NULL;
+}
+
+/* spins briefly, then gives the CPU away so a waiting consumer or producer can run */
+static inline void ring_wait(unsigned int* spins)
+{
+    if (++*spins < 64)
+        _mm_pause();
+    else
+        sched_yield();
+}
+
+void log_ring_push(LogRing* r, int src_ip, const char* URL, size_t url_len, long reference_time,
+                   const char* bro, size_t bro_len, int status)
+{
+    size_t pos = atomic_fetch_add_explicit(&r->head, 1, memory_order_relaxed);
+    LogRingSlot* slot = &r->slots[pos & r->mask];
+    unsigned int spins = 0;
+    while (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos)
+    {
+        ring_wait(&spins);
+    }
+
+    LogEvent* e = &slot->ev;
+    e->src_ip = src_ip;
+    e->status = status;
+    e->reference_time = reference_time;
+    e->url_len = url_len < LOG_STR_MAX ? url_len : LOG_STR_MAX;
+    e->bro_len = bro_len < LOG_STR_MAX ? bro_len : LOG_STR_MAX;
+    memcpy(e->URL, URL, e->url_len);
+    memcpy(e->bro, bro, e->bro_len);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+size_t log_ring_drain(LogRing* r, LogStore* s, size_t max)
+{
+    size_t n, pos = r->tail;
+    for (n = 0; n < max; n++, pos++)
+    {
+        LogRingSlot* slot = &r->slots[pos & r->mask];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1)
+        {
+            break;
+        }
+        /* the next slot is usually published already */
+        __builtin_prefetch(&r->slots[(pos + 1) & r->mask]);
+        const LogEvent* e = &slot->ev;
+        log_store_append_fields(s, e->src_ip, e->URL, e->url_len, e->reference_time, e->bro, e->bro_len, e->status);
+        atomic_store_explicit(&slot->seq, pos + r->mask + 1, memory_order_release);
+    }
+    r->tail = pos;
+    return n;
+}
@@ -0,0 +1,58 @@
+/**
+ * Partitioned parallel scans over the log store.
+ * The table is cut into one contiguous range per thread. Range boundaries are
+ * multiples of LOG_SCAN_ROWS rows, which puts them on a 64-byte line in every
+ * column and on a word of the active bitmap, so threads never share a cache
+ * line they write. The workers are OpenMP's: the runtime keeps its thread
+ * team alive between parallel regions, so repeated scans reuse the same pool
+ * instead of creating threads.
+ */
+#include "log_store.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+int log_max_threads(void)
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+void log_scan_parallel(LogStore* s, LogScanFn fn, void* ctx, int threads)
+{
+    size_t blocks = (s->rows + LOG_SCAN_ROWS - 1) / LOG_SCAN_ROWS;
+    if (threads <= 0)
+    {
+        threads = log_max_threads();
+    }
+    if ((size_t)threads > blocks)
+    {
+        threads = blocks ? blocks : 1;
+    }
+    if (threads == 1)
+    {
+        fn(s, 0, s->rows, 0, ctx);
+        return;
+    }
+#pragma omp parallel num_threads(threads)
+    {
+        int tid = 0, nt = 1;
+#ifdef _OPENMP
+        tid = omp_get_thread_num();
+        nt = omp_get_num_threads();
+#endif
+        size_t begin = blocks * tid / nt * LOG_SCAN_ROWS;
+        size_t end = blocks * (tid + 1) / nt * LOG_SCAN_ROWS;
+        if (end > s->rows)
+        {
+            end = s->rows;
+        }
+        if (begin < end)
+        {
+            fn(s, begin, end, tid, ctx);
+        }
+    }
+}
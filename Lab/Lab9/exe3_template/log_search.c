@@ -0,0 +1,181 @@
+/**
+ * Substring search over the URL column.
+ * Rows hold dictionary codes, so the pattern is searched once per distinct
+ * string, in the dictionary arena where the strings sit back to back, and
+ * rows are then matched by code. The arena scan is the generic SIMD
+ * substring search: 32 candidate positions at a time are kept only when the
+ * first byte of the pattern is at the position and its last byte is
+ * pattern length - 1 further on, two AVX2 compares and an AND; the few
+ * candidates left are checked with memcmp. A match cannot run across the
+ * NUL that ends a string, and after one hit the scan jumps to the next
+ * string. Threads take byte ranges of the arena cut at string boundaries.
+ */
+#include "log_store.h"
+#include <immintrin.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* arena bytes per thread below which more threads do not pay */
+#define SEARCH_MIN_BYTES 65536
+
+/* first code whose string starts at or after byte pos */
+static uint32_t code_at(const LogDict* d, size_t pos)
+{
+    uint32_t lo = 0, hi = d->count;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (d->offset[mid] < pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* start of the string after code, or the end of the arena */
+static inline size_t next_string(const LogDict* d, uint32_t code)
+{
+    return code + 1 < d->count ? d->offset[code + 1] : d->arena_len;
+}
+
+/* marks the codes in [begin, end) whose string contains p[0, k), k >= 1; returns how many */
+static size_t search_codes(const LogDict* d, uint32_t begin, uint32_t end, const char* p, size_t k, uint8_t* match)
+{
+    const char* a = d->arena;
+    size_t i = begin < d->count ? d->offset[begin] : d->arena_len;
+    size_t stop = end < d->count ? d->offset[end] : d->arena_len;
+    size_t hits = 0;
+    uint32_t code = begin;
+    const __m256i first = _mm256_set1_epi8(p[0]);
+    const __m256i last = _mm256_set1_epi8(p[k - 1]);
+
+    memset(match + begin, 0, end - begin);
+    while (i + k - 1 + 32 <= stop)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(a + i + k - 1));
+        uint32_t m = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(x, first), _mm256_cmpeq_epi8(y, last)));
+        size_t next = i + 32;
+        while (m)
+        {
+            size_t pos = i + __builtin_ctz(m);
+            if (k < 3 || memcmp(a + pos + 1, p + 1, k - 2) == 0)
+            {
+                while (next_string(d, code) <= pos)
+                    code++;
+                match[code] = 1;
+                hits++;
+                next = next_string(d, code);
+                break;
+            }
+            m &= m - 1;
+        }
+        i = next;
+    }
+    /* the last bytes of the range, one position at a time */
+    for (; i + k <= stop; i++)
+    {
+        if (a[i] == p[0] && a[i + k - 1] == p[k - 1] && memcmp(a + i, p, k) == 0)
+        {
+            while (next_string(d, code) <= i)
+                code++;
+            match[code] = 1;
+            hits++;
+            i = next_string(d, code) - 1;
+        }
+    }
+    return hits;
+}
+
+size_t log_dict_search(const LogDict* d, const char* pattern, uint8_t* match, int threads)
+{
+    size_t k = strlen(pattern), hits = 0;
+    if (k == 0)
+    {
+        memset(match, 1, d->count);
+        return d->count;
+    }
+    if (threads <= 0)
+    {
+        threads = log_max_threads();
+    }
+    if ((size_t)threads > d->arena_len / SEARCH_MIN_BYTES + 1)
+    {
+        threads = d->arena_len / SEARCH_MIN_BYTES + 1;
+    }
+    if (threads == 1)
+    {
+        return search_codes(d, 0, d->count, pattern, k, match);
+    }
+#pragma omp parallel num_threads(threads) reduction(+ : hits)
+    {
+        int tid = 0, nt = 1;
+#ifdef _OPENMP
+        tid = omp_get_thread_num();
+        nt = omp_get_num_threads();
+#endif
+        uint32_t begin = code_at(d, d->arena_len * tid / nt);
+        uint32_t end = code_at(d, d->arena_len * (tid + 1) / nt);
+        if (begin < end)
+        {
+            hits += search_codes(d, begin, end, pattern, k, match);
+        }
+    }
+    return hits;
+}
+
+typedef struct UrlSearch
+{
+    const uint8_t* match;       /* by URL code */
+    uint64_t* mask;
+    size_t rows;
+} UrlSearch;
+
+static void search_range(LogStore* s, size_t begin, size_t end, int tid, void* ctx)
+{
+    UrlSearch* u = ctx;
+    size_t base, rows = 0;
+    (void)tid;
+    for (base = begin; base < end; base += 64)
+    {
+        uint64_t m = 0;
+        int k, n = end - base < 64 ? (int)(end - base) : 64;
+        for (k = 0; k < n; k++)
+            m |= (uint64_t)u->match[s->URL[base + k]] << k;
+        if (u->mask)
+            u->mask[base / 64] = m;
+        rows += __builtin_popcountll(m);
+    }
+#pragma omp atomic
+    u->rows += rows;
+}
+
+size_t log_url_match(LogStore* s, const uint8_t* match, uint64_t* mask)
+{
+    UrlSearch u = {match, mask, 0};
+    log_scan_parallel(s, search_range, &u, s->threads);
+    return u.rows;
+}
+
+size_t log_url_search(LogStore* s, const char* pattern, uint64_t* mask)
+{
+    size_t rows = 0;
+    uint8_t* match = malloc(s->urls.count ? s->urls.count : 1);
+    if (!match)
+    {
+        printf("log search: out of memory\n");
+        exit(-1);
+    }
+    if (log_dict_search(&s->urls, pattern, match, s->threads) > 0)
+    {
+        rows = log_url_match(s, match, mask);
+    }
+    else if (mask)
+    {
+        memset(mask, 0, (s->rows + 63) / 64 * sizeof(uint64_t));
+    }
+    free(match);
+    return rows;
+}
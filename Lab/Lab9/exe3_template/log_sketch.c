@@ -0,0 +1,410 @@
+/**
+ * Streaming sketches of the URL and src_ip columns in fixed memory, however
+ * many rows go through them.
+ *
+ * Heavy hitters: a Count-Min sketch of LOG_CM_DEPTH rows of counters keyed by
+ * the dictionary hash of the URL, so rows of a store are counted without
+ * touching the strings. An estimate is the smallest of the row's counters and
+ * never falls below the true count. Next to it a min-heap keeps the
+ * LOG_TOPK URLs with the largest estimates; a URL whose new estimate does not
+ * beat the heap minimum cannot be in the heap, so most rows stop after the
+ * counters.
+ *
+ * Distinct src_ip: a HyperLogLog of 2^LOG_HLL_BITS one-byte registers.
+ *
+ * Both are mergeable: counters add and registers take the maximum, 32 at a
+ * time with AVX2, so the sketch of a stream does not depend on how it was
+ * split between threads. The heaps of a merge are rebuilt from both sets of
+ * candidates, estimated again on the merged counters.
+ */
+#include "log_store.h"
+#include <immintrin.h>
+#include <math.h>
+
+#define CM_WIDTH (1u << LOG_CM_BITS)
+#define HLL_REGS (1u << LOG_HLL_BITS)
+#define LOG_SKETCH_MAGIC "LOGSKCH"
+#define LOG_SKETCH_VERSION 1
+
+typedef struct LogSketchHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t cm_depth, cm_bits, hll_bits, topk;
+    int32_t ntop;
+    uint64_t rows;
+} LogSketchHeader;
+
+/* multiply-add-shift hashing, one odd multiplier and offset per counter row */
+static const uint64_t cm_mult[LOG_CM_DEPTH] = {
+    0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull, 0xd6e8feb86659fd93ull};
+static const uint64_t cm_add[LOG_CM_DEPTH] = {
+    0x27d4eb2f165667c5ull, 0x85ebca77c2b2ae63ull, 0x94d049bb133111ebull, 0xbf58476d1ce4e5b9ull};
+
+static inline uint32_t cm_slot(uint32_t h, int row)
+{
+    return (uint32_t)((h * cm_mult[row] + cm_add[row]) >> (64 - LOG_CM_BITS));
+}
+
+/* increments the counters of h and returns its new estimate */
+static inline uint32_t cm_update(uint32_t* cm, uint32_t h)
+{
+    uint32_t est = UINT32_MAX;
+    int r;
+    for (r = 0; r < LOG_CM_DEPTH; r++)
+    {
+        uint32_t v = ++cm[(size_t)r * CM_WIDTH + cm_slot(h, r)];
+        est = v < est ? v : est;
+    }
+    return est;
+}
+
+static inline uint32_t cm_query(const uint32_t* cm, uint32_t h)
+{
+    uint32_t est = UINT32_MAX;
+    int r;
+    for (r = 0; r < LOG_CM_DEPTH; r++)
+    {
+        uint32_t v = cm[(size_t)r * CM_WIDTH + cm_slot(h, r)];
+        est = v < est ? v : est;
+    }
+    return est;
+}
+
+static inline void hll_add(uint8_t* reg, int src_ip)
+{
+    /* splitmix64 finalizer */
+    uint64_t x = (uint32_t)src_ip;
+    x = (x ^ x >> 30) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ x >> 27) * 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    uint32_t j = (uint32_t)(x >> (64 - LOG_HLL_BITS));
+    /* leading zeros of the remaining bits, plus one; the guard bit bounds it */
+    uint8_t rank = __builtin_clzll(x << LOG_HLL_BITS | 1ull << (LOG_HLL_BITS - 1)) + 1;
+    if (rank > reg[j])
+    {
+        reg[j] = rank;
+    }
+}
+
+static void* sketch_alloc(size_t bytes)
+{
+    void* p = aligned_alloc(LOG_ALIGN, bytes);
+    if (!p)
+    {
+        printf("log sketch: out of memory\n");
+        exit(-1);
+    }
+    memset(p, 0, bytes);
+    return p;
+}
+
+void log_sketch_init(LogSketch* k)
+{
+    memset(k, 0, sizeof(*k));
+    k->cm = sketch_alloc((size_t)LOG_CM_DEPTH * CM_WIDTH * sizeof(uint32_t));
+    k->hll = sketch_alloc(HLL_REGS);
+}
+
+void log_sketch_free(LogSketch* k)
+{
+    free(k->cm);
+    free(k->hll);
+    k->cm = NULL;
+    k->hll = NULL;
+}
+
+size_t log_sketch_bytes(const LogSketch* k)
+{
+    (void)k;
+    return sizeof(LogSketch) + (size_t)LOG_CM_DEPTH * CM_WIDTH * sizeof(uint32_t) + HLL_REGS;
+}
+
+/* heap position of hash h, or -1 */
+static inline int heap_find(const LogSketch* k, uint32_t h)
+{
+    __m256i key = _mm256_set1_epi32((int)h);
+    int i;
+    for (i = 0; i < k->ntop; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(k->top_hash + i));
+        unsigned int m = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, key)));
+        if (k->ntop - i < 8)
+            m &= (1u << (k->ntop - i)) - 1;
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+    return -1;
+}
+
+static inline void heap_swap(LogSketch* k, int a, int b)
+{
+    LogHeavy t = k->top[a];
+    uint32_t h = k->top_hash[a];
+    k->top[a] = k->top[b];
+    k->top_hash[a] = k->top_hash[b];
+    k->top[b] = t;
+    k->top_hash[b] = h;
+}
+
+static void sift_down(LogSketch* k, int i)
+{
+    for (;;)
+    {
+        int c = 2 * i + 1, m = i;
+        if (c < k->ntop && k->top[c].count < k->top[m].count)
+            m = c;
+        if (c + 1 < k->ntop && k->top[c + 1].count < k->top[m].count)
+            m = c + 1;
+        if (m == i)
+            return;
+        heap_swap(k, i, m);
+        i = m;
+    }
+}
+
+static void sift_up(LogSketch* k, int i)
+{
+    while (i > 0 && k->top[(i - 1) / 2].count > k->top[i].count)
+    {
+        heap_swap(k, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+/* URL was not in the heap and beats its minimum, or the heap has room */
+static void heap_insert(LogSketch* k, uint32_t h, uint32_t count, const char* URL, size_t len)
+{
+    int i = k->ntop < LOG_TOPK ? k->ntop++ : 0;
+    LogHeavy* e = &k->top[i];
+    if (len > LOG_STR_MAX)
+    {
+        len = LOG_STR_MAX;
+    }
+    e->hash = h;
+    e->count = count;
+    memcpy(e->URL, URL, len);
+    e->URL[len] = 0;
+    k->top_hash[i] = h;
+    if (i)
+        sift_up(k, i);
+    else
+        sift_down(k, 0);
+}
+
+/* URL of hash h has just reached estimate est; len is SIZE_MAX when URL is NUL-terminated */
+static inline void heavy_offer(LogSketch* k, uint32_t h, uint32_t est, const char* URL, size_t len)
+{
+    /* a heap entry's estimate was lower before this row, so it would now beat the minimum */
+    if (k->ntop == LOG_TOPK && est <= k->top[0].count)
+    {
+        return;
+    }
+    int i = heap_find(k, h);
+    if (i >= 0)
+    {
+        k->top[i].count = est;
+        sift_down(k, i);
+        return;
+    }
+    heap_insert(k, h, est, URL, len == SIZE_MAX ? strlen(URL) : len);
+}
+
+void log_sketch_add(LogSketch* k, const char* URL, size_t url_len, int src_ip)
+{
+    /* cut like appends cut, so the hash matches the dictionary's */
+    url_len = url_len < LOG_STR_MAX ? url_len : LOG_STR_MAX;
+    uint32_t h = log_str_hash(URL, url_len);
+    heavy_offer(k, h, cm_update(k->cm, h), URL, url_len);
+    hll_add(k->hll, src_ip);
+    k->rows++;
+}
+
+typedef struct SketchScan
+{
+    LogSketch* into;
+    LogSketch* parts;           /* one per worker but the first, which adds to into */
+} SketchScan;
+
+static void sketch_range(LogStore* s, size_t begin, size_t end, int tid, void* ctx)
+{
+    SketchScan* u = ctx;
+    LogSketch* k = tid ? &u->parts[tid] : u->into;
+    const LogDict* urls = &s->urls;
+    size_t i;
+    if (tid)
+    {
+        /* allocated by the worker, so its pages are local to it */
+        log_sketch_init(k);
+    }
+    for (i = begin; i < end; i++)
+    {
+        uint32_t code = s->URL[i];
+        uint32_t h = urls->hash[code];
+        heavy_offer(k, h, cm_update(k->cm, h), urls->arena + urls->offset[code], SIZE_MAX);
+        hll_add(k->hll, s->src_ip[i]);
+    }
+    k->rows += end - begin;
+}
+
+void log_sketch_scan(LogSketch* k, LogStore* s)
+{
+    int threads = s->threads > 0 ? s->threads : log_max_threads();
+    int i;
+    SketchScan u = {k, calloc(threads, sizeof(LogSketch))};
+    log_scan_parallel(s, sketch_range, &u, threads);
+    for (i = 1; i < threads; i++)
+    {
+        if (u.parts[i].cm)
+        {
+            log_sketch_merge(k, &u.parts[i]);
+            log_sketch_free(&u.parts[i]);
+        }
+    }
+    free(u.parts);
+}
+
+void log_sketch_merge(LogSketch* k, const LogSketch* other)
+{
+    size_t i;
+    int j, n = 0;
+    LogHeavy cand[2 * LOG_TOPK];
+
+    for (i = 0; i < (size_t)LOG_CM_DEPTH * CM_WIDTH; i += 8)
+    {
+        __m256i a = _mm256_load_si256((const __m256i*)(k->cm + i));
+        __m256i b = _mm256_load_si256((const __m256i*)(other->cm + i));
+        _mm256_store_si256((__m256i*)(k->cm + i), _mm256_add_epi32(a, b));
+    }
+    for (i = 0; i < HLL_REGS; i += 32)
+    {
+        __m256i a = _mm256_load_si256((const __m256i*)(k->hll + i));
+        __m256i b = _mm256_load_si256((const __m256i*)(other->hll + i));
+        _mm256_store_si256((__m256i*)(k->hll + i), _mm256_max_epu8(a, b));
+    }
+    k->rows += other->rows;
+
+    /* candidates from both heaps, once each, on the merged counters */
+    memcpy(cand, k->top, k->ntop * sizeof(LogHeavy));
+    n = k->ntop;
+    for (j = 0; j < other->ntop; j++)
+    {
+        if (heap_find(k, other->top[j].hash) < 0)
+            cand[n++] = other->top[j];
+    }
+    k->ntop = 0;
+    for (j = 0; j < n; j++)
+    {
+        uint32_t est = cm_query(k->cm, cand[j].hash);
+        if (k->ntop < LOG_TOPK || est > k->top[0].count)
+            heap_insert(k, cand[j].hash, est, cand[j].URL, strlen(cand[j].URL));
+    }
+}
+
+uint32_t log_sketch_count(const LogSketch* k, const char* URL)
+{
+    size_t len = strnlen(URL, LOG_STR_MAX);
+    return cm_query(k->cm, log_str_hash(URL, len));
+}
+
+double log_sketch_distinct(const LogSketch* k)
+{
+    double m = HLL_REGS, sum = 0;
+    size_t i, zeros = 0;
+    for (i = 0; i < HLL_REGS; i++)
+    {
+        sum += ldexp(1.0, -k->hll[i]);
+        zeros += k->hll[i] == 0;
+    }
+    double e = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    /* small cardinalities: linear counting on the empty registers */
+    if (e <= 2.5 * m && zeros)
+    {
+        e = m * log(m / zeros);
+    }
+    return e;
+}
+
+int log_sketch_top(const LogSketch* k, LogHeavy* out)
+{
+    int i, j;
+    /* heap entries keep the estimate of their last update; report the current one */
+    for (i = 0; i < k->ntop; i++)
+    {
+        LogHeavy e = k->top[i];
+        e.count = cm_query(k->cm, e.hash);
+        for (j = i; j > 0 && out[j - 1].count < e.count; j--)
+            out[j] = out[j - 1];
+        out[j] = e;
+    }
+    return k->ntop;
+}
+
+int log_sketch_save(const LogSketch* k, const char* path)
+{
+    LogSketchHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LOG_SKETCH_MAGIC, sizeof(h.magic));
+    h.version = LOG_SKETCH_VERSION;
+    h.cm_depth = LOG_CM_DEPTH;
+    h.cm_bits = LOG_CM_BITS;
+    h.hll_bits = LOG_HLL_BITS;
+    h.topk = LOG_TOPK;
+    h.ntop = k->ntop;
+    h.rows = k->rows;
+
+    FILE* f = fopen(path, "wb");
+    if (!f)
+    {
+        printf("cannot write %s\n", path);
+        return -1;
+    }
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1
+             && fwrite(k->cm, sizeof(uint32_t), (size_t)LOG_CM_DEPTH * CM_WIDTH, f) == (size_t)LOG_CM_DEPTH * CM_WIDTH
+             && fwrite(k->hll, 1, HLL_REGS, f) == HLL_REGS
+             && fwrite(k->top, sizeof(LogHeavy), k->ntop, f) == (size_t)k->ntop;
+    if (fclose(f) != 0 || !ok)
+    {
+        printf("error writing %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int log_sketch_load(LogSketch* k, const char* path)
+{
+    LogSketchHeader h;
+    int i;
+    FILE* f = fopen(path, "rb");
+    if (!f)
+    {
+        printf("cannot open %s\n", path);
+        return -1;
+    }
+    if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, LOG_SKETCH_MAGIC, sizeof(h.magic)) != 0
+        || h.version != LOG_SKETCH_VERSION || h.cm_depth != LOG_CM_DEPTH || h.cm_bits != LOG_CM_BITS
+        || h.hll_bits != LOG_HLL_BITS || h.topk != LOG_TOPK || h.ntop < 0 || h.ntop > LOG_TOPK)
+    {
+        printf("%s is not a version %d sketch of this size\n", path, LOG_SKETCH_VERSION);
+        fclose(f);
+        return -1;
+    }
+    log_sketch_init(k);
+    k->rows = h.rows;
+    k->ntop = h.ntop;
+    int ok = fread(k->cm, sizeof(uint32_t), (size_t)LOG_CM_DEPTH * CM_WIDTH, f) == (size_t)LOG_CM_DEPTH * CM_WIDTH
+             && fread(k->hll, 1, HLL_REGS, f) == HLL_REGS
+             && fread(k->top, sizeof(LogHeavy), k->ntop, f) == (size_t)k->ntop;
+    fclose(f);
+    if (!ok)
+    {
+        printf("%s is truncated\n", path);
+        log_sketch_free(k);
+        return -1;
+    }
+    for (i = 0; i < k->ntop; i++)
+    {
+        k->top_hash[i] = k->top[i].hash;
+    }
+    return 0;
+}
@@ -0,0 +1,358 @@
+/**
+ * Columnar log store: hot columns, dictionary-coded strings, the active-row
+ * bitmap, the dirty-block bitmap and the record accessors.
+ */
+#include "log_store.h"
+#include <sys/mman.h>
+
+/* words of the dirty bitmap for a capacity: one bit per 64-row block */
+static size_t dirty_words(size_t capacity)
+{
+    return (capacity / 64 + 63) / 64;
+}
+
+static void* col_alloc(size_t bytes)
+{
+    /* aligned_alloc wants a multiple of the alignment */
+    void* p = aligned_alloc(LOG_ALIGN, (bytes + LOG_ALIGN - 1) / LOG_ALIGN * LOG_ALIGN);
+    if (!p)
+    {
+        printf("log store: out of memory (%zu bytes)\n", bytes);
+        exit(-1);
+    }
+    return p;
+}
+
+/* aligned columns cannot be realloc'd, so growing copies into a fresh column */
+static void* col_grow(void* old, size_t used, size_t bytes)
+{
+    void* p = col_alloc(bytes);
+    if (old)
+    {
+        memcpy(p, old, used);
+        free(old);
+    }
+    return p;
+}
+
+void log_store_init(LogStore* s, size_t capacity)
+{
+    memset(s, 0, sizeof(*s));
+    /* whole 64-row blocks, so block kernels never run off the end of a column */
+    s->capacity = capacity ? (capacity + 63) / 64 * 64 : 64;
+    s->status = col_alloc(s->capacity * sizeof(int));
+    s->src_ip = col_alloc(s->capacity * sizeof(int));
+    s->reference_time = col_alloc(s->capacity * sizeof(long));
+    s->URL = col_alloc(s->capacity * sizeof(uint32_t));
+    s->bro = col_alloc(s->capacity * sizeof(uint32_t));
+    log_dict_init(&s->urls);
+    log_dict_init(&s->bros);
+    s->active = col_alloc((s->capacity + 63) / 64 * sizeof(uint64_t));
+    memset(s->active, 0, (s->capacity + 63) / 64 * sizeof(uint64_t));
+    s->zone_min = col_alloc(s->capacity / 64 * sizeof(long));
+    s->zone_max = col_alloc(s->capacity / 64 * sizeof(long));
+    s->zone_upto = col_alloc(s->capacity / 64 * sizeof(long));
+    s->dirty = col_alloc(dirty_words(s->capacity) * sizeof(uint64_t));
+    memset(s->dirty, 0, dirty_words(s->capacity) * sizeof(uint64_t));
+}
+
+void log_store_free(LogStore* s)
+{
+    log_ip_index_drop(s);
+    free(s->dirty);
+    if (s->map)
+    {
+        /* every other array points into the mapping */
+        munmap(s->map, s->map_bytes);
+        memset(s, 0, sizeof(*s));
+        return;
+    }
+    free(s->status);
+    free(s->src_ip);
+    free(s->reference_time);
+    free(s->URL);
+    free(s->bro);
+    log_dict_free(&s->urls);
+    log_dict_free(&s->bros);
+    free(s->active);
+    free(s->zone_min);
+    free(s->zone_max);
+    free(s->zone_upto);
+    memset(s, 0, sizeof(*s));
+}
+
+static void reserve(LogStore* s, size_t rows)
+{
+    size_t n = s->rows, cap = s->capacity;
+    if (rows <= cap)
+    {
+        return;
+    }
+    while (cap < rows)
+    {
+        cap *= 2;
+    }
+    s->status = col_grow(s->status, n * sizeof(int), cap * sizeof(int));
+    s->src_ip = col_grow(s->src_ip, n * sizeof(int), cap * sizeof(int));
+    s->reference_time = col_grow(s->reference_time, n * sizeof(long), cap * sizeof(long));
+    s->URL = col_grow(s->URL, n * sizeof(uint32_t), cap * sizeof(uint32_t));
+    s->bro = col_grow(s->bro, n * sizeof(uint32_t), cap * sizeof(uint32_t));
+    s->active = col_grow(s->active, (s->capacity + 63) / 64 * sizeof(uint64_t), (cap + 63) / 64 * sizeof(uint64_t));
+    memset(s->active + (s->capacity + 63) / 64, 0, ((cap + 63) / 64 - (s->capacity + 63) / 64) * sizeof(uint64_t));
+    s->zone_min = col_grow(s->zone_min, (n + 63) / 64 * sizeof(long), cap / 64 * sizeof(long));
+    s->zone_max = col_grow(s->zone_max, (n + 63) / 64 * sizeof(long), cap / 64 * sizeof(long));
+    s->zone_upto = col_grow(s->zone_upto, (n + 63) / 64 * sizeof(long), cap / 64 * sizeof(long));
+    s->dirty = col_grow(s->dirty, dirty_words(s->capacity) * sizeof(uint64_t), dirty_words(cap) * sizeof(uint64_t));
+    memset(s->dirty + dirty_words(s->capacity), 0, (dirty_words(cap) - dirty_words(s->capacity)) * sizeof(uint64_t));
+    s->capacity = cap;
+}
+
+size_t log_store_append_fields(LogStore* s, int src_ip, const char* URL, size_t url_len,
+                               long reference_time, const char* bro, size_t bro_len, int status)
+{
+    size_t row = s->rows;
+    if (s->map)
+    {
+        log_store_unmap(s);
+    }
+    reserve(s, row + 1);
+    s->status[row] = status;
+    s->src_ip[row] = src_ip;
+    s->reference_time[row] = reference_time;
+    s->URL[row] = log_dict_intern_n(&s->urls, URL, url_len < LOG_STR_MAX ? url_len : LOG_STR_MAX);
+    s->bro[row] = log_dict_intern_n(&s->bros, bro, bro_len < LOG_STR_MAX ? bro_len : LOG_STR_MAX);
+    if (status)
+    {
+        s->active[row / 64] |= 1ULL << (row % 64);
+        s->active_rows++;
+    }
+    s->rows = row + 1;
+    if (row % 64 == 0)
+    {
+        s->zone_min[row / 64] = s->zone_max[row / 64] = reference_time;
+    }
+    log_zone_widen(s, row / 64, reference_time);
+    log_zone_fix_upto(s, row / 64);
+    s->dirty[row / 4096] |= 1ULL << (row / 64 % 64);
+    s->dirty_current = 0;
+    if (s->ip_index)
+    {
+        log_ip_index_add(s, src_ip, row);
+    }
+    return row;
+}
+
+size_t log_store_append(LogStore* s, const LogRecord* r)
+{
+    return log_store_append_fields(s, r->src_ip, r->URL, strnlen(r->URL, LOG_STR_LEN), r->reference_time,
+                                   r->bro, strnlen(r->bro, LOG_STR_LEN), r->status);
+}
+
+void log_store_get(const LogStore* s, size_t row, LogRecord* r)
+{
+    r->src_ip = s->src_ip[row];
+    r->reference_time = s->reference_time[row];
+    r->status = s->status[row];
+    /* appends keep at most LOG_STR_MAX bytes; the NUL is written anyway, whatever a mapped file holds */
+    strncpy(r->URL, log_dict_str(&s->urls, s->URL[row]), LOG_STR_MAX);
+    r->URL[LOG_STR_MAX] = 0;
+    strncpy(r->bro, log_dict_str(&s->bros, s->bro[row]), LOG_STR_MAX);
+    r->bro[LOG_STR_MAX] = 0;
+}
+
+void log_store_set_status(LogStore* s, size_t row, int status)
+{
+    uint64_t bit = 1ULL << (row % 64);
+    int was = (s->active[row / 64] & bit) != 0;
+    s->status[row] = status;
+    s->dirty[row / 4096] |= 1ULL << (row / 64 % 64);
+    s->dirty_current = 0;
+    if (status && !was)
+    {
+        s->active[row / 64] |= bit;
+        s->active_rows++;
+    }
+    else if (!status && was)
+    {
+        s->active[row / 64] &= ~bit;
+        s->active_rows--;
+    }
+}
+
+size_t log_active_next(const LogStore* s, size_t row)
+{
+    size_t w = row / 64, words = (s->rows + 63) / 64;
+    if (row >= s->rows)
+    {
+        return s->rows;
+    }
+    uint64_t bits = s->active[w] & (~0ULL << (row % 64));
+    while (!bits)
+    {
+        if (++w >= words)
+        {
+            return s->rows;
+        }
+        bits = s->active[w];
+    }
+    return w * 64 + __builtin_ctzll(bits);
+}
+
+size_t log_active_rows(const LogStore* s, size_t begin, size_t end, uint32_t* out)
+{
+    size_t n = 0, w;
+    if (end > s->rows)
+    {
+        end = s->rows;
+    }
+    if (begin >= end)
+    {
+        return 0;
+    }
+    for (w = begin / 64; w <= (end - 1) / 64; w++)
+    {
+        uint64_t bits = s->active[w];
+        if (w == begin / 64)
+        {
+            bits &= ~0ULL << (begin % 64);
+        }
+        if (w == (end - 1) / 64 && end % 64)
+        {
+            bits &= ~0ULL >> (64 - end % 64);
+        }
+        while (bits)
+        {
+            out[n++] = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+        }
+    }
+    return n;
+}
+
+/* same synthetic table as make_logs() in log_base.c */
+void log_make_logs(LogStore* s, size_t n)
+{
+    LogRecord r;
+    size_t i;
+    memset(&r, 0, sizeof(r));
+    for (i = 0; i < n; i++)
+    {
+        r.src_ip = i * 123;
+        r.reference_time = i * 123;
+        r.status = 1;
+        log_store_append(s, &r);
+    }
+}
+
+static const char* traffic_browsers[] =
+{
+    "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0 Safari/537.36",
+    "Mozilla/5.0 (Macintosh; Intel Mac OS X 14_4) AppleWebKit/605.1.15 (KHTML, like Gecko) Version/17.4 Safari/605.1.15",
+    "Mozilla/5.0 (X11; Linux x86_64; rv:125.0) Gecko/20100101 Firefox/125.0",
+    "Mozilla/5.0 (iPhone; CPU iPhone OS 17_4 like Mac OS X) AppleWebKit/605.1.15 (KHTML, like Gecko) Mobile/15E148",
+    "Mozilla/5.0 (Linux; Android 14) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0 Mobile Safari/537.36",
+    "curl/8.5.0",
+    "Googlebot/2.1 (+http://www.google.com/bot.html)",
+    "python-requests/2.31.0",
+};
+
+static const char* traffic_dirs[] = {"", "/static/js", "/static/css", "/img", "/api/v1/users", "/api/v1/orders", "/blog", "/docs"};
+
+static const int traffic_status[] = {200, 200, 200, 200, 200, 200, 304, 304, 404, 500, 301, 0};
+
+/*
+ * URLs follow a rough power law (a few pages get most hits), browsers are
+ * drawn from a short list, times increase by 0-3 seconds per row with the
+ * odd out-of-order entry, and about 1 row in 12 is inactive (status 0).
+ */
+void log_make_traffic(LogStore* s, size_t n, unsigned int seed)
+{
+    LogRecord r;
+    size_t i;
+    long t = 1700000000;
+    unsigned int x = seed * 2654435761u + 1;
+    memset(&r, 0, sizeof(r));
+    for (i = 0; i < n; i++)
+    {
+        x = x * 1103515245u + 12345u;
+        unsigned int u = (x >> 8) % 4096;
+        unsigned int page = u * u / 4096 * u / 4096;
+        snprintf(r.URL, LOG_STR_LEN, "%s/page%u.html", traffic_dirs[page % 8], page);
+        x = x * 1103515245u + 12345u;
+        strcpy(r.bro, traffic_browsers[(x >> 20) % 2 ? (x >> 16) % 8 : (x >> 24) % 2]);
+        r.src_ip = (int)(0x0a000000u | ((x >> 4) % 65536));
+        t += (x >> 12) % 4;
+        r.reference_time = (x >> 3) % 64 ? t : t - (long)((x >> 9) % 600);
+        r.status = traffic_status[(x >> 14) % 12];
+        log_store_append(s, &r);
+    }
+}
+
+void log_check(int ok, const char* what)
+{
+    if (!ok)
+    {
+        printf("check failed: %s\n", what);
+        exit(-1);
+    }
+}
+
+double log_now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+size_t log_store_bytes(const LogStore* s)
+{
+    size_t rows = s->capacity;
+    size_t cols = rows * (2 * sizeof(int) + sizeof(long) + 2 * sizeof(uint32_t))
+                + rows / 64 * (sizeof(uint64_t) + 3 * sizeof(long)) + dirty_words(rows) * sizeof(uint64_t);
+    size_t dicts = s->urls.arena_cap + s->bros.arena_cap
+                 + (size_t)(s->urls.code_cap + s->bros.code_cap) * 2 * sizeof(uint32_t)
+                 + (size_t)(s->urls.mask + 1 + s->bros.mask + 1) * sizeof(uint32_t);
+    return cols + dicts;
+}
+
+void log_mark_dirty(LogStore* s, size_t begin, size_t end)
+{
+    size_t b;
+    for (b = begin / 64; b < (end + 63) / 64; b++)
+    {
+        s->dirty[b / 64] |= 1ULL << (b % 64);
+    }
+    s->dirty_current = 0;
+}
+
+size_t log_dirty_blocks(const LogStore* s)
+{
+    size_t w, n = 0;
+    for (w = 0; w < dirty_words(s->capacity); w++)
+    {
+        n += __builtin_popcountll(s->dirty[w]);
+    }
+    return n;
+}
+
+uint64_t log_epoch_advance(LogStore* s)
+{
+    memset(s->dirty, 0, dirty_words(s->capacity) * sizeof(uint64_t));
+    /* rows written after the keyed update ran are clean from now on without it */
+    if (!s->dirty_current)
+    {
+        s->dirty_keyed = 0;
+    }
+    return ++s->epoch;
+}
+
+void log_count_codes(const LogStore* s, LogColumn col, size_t* counts)
+{
+    const uint32_t* codes = col == LOG_COL_URL ? s->URL : s->bro;
+    size_t i;
+    memset(counts, 0, (col == LOG_COL_URL ? s->urls.count : s->bros.count) * sizeof(size_t));
+    for (i = 0; i < s->rows; i++)
+    {
+        counts[codes[i]]++;
+    }
+}
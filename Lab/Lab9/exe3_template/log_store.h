@@ -0,0 +1,383 @@
+/**
+ * Columnar store for the web log engine.
+ * struct log_entry in log_base.c keeps 256 bytes of strings next to the 16
+ * bytes traverse() reads and writes, so every scan drags the strings through
+ * the cache. Here each hot field is its own 64-byte aligned array and the
+ * strings are dictionary encoded: every distinct URL and browser string is
+ * stored once and rows hold 32-bit codes, so string equality and group-by
+ * are integer operations. Full records are rebuilt (decoded) on demand.
+ * A bitmap with one bit per row mirrors status != 0, so filtered scans walk
+ * set bits and cost grows with the number of active rows, not the table size.
+ * status must therefore only be changed through log_store_set_status or
+ * log_update_where, which keep the bitmap in step.
+ */
+#ifndef LOG_STORE_H
+#define LOG_STORE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define NUM_ENTRIES 409600
+#define LOG_STR_LEN 128
+/* longest string a field keeps: a LogRecord field also holds its NUL */
+#define LOG_STR_MAX (LOG_STR_LEN - 1)
+#define LOG_ALIGN 64
+
+/* one full row, field for field the same as struct log_entry */
+typedef struct LogRecord
+{
+    int src_ip;
+    char URL[LOG_STR_LEN];
+    long reference_time;
+    char bro[LOG_STR_LEN];
+    int status;
+} LogRecord;
+
+/* code returned by log_dict_find for a string that was never interned */
+#define LOG_NO_CODE 0xffffffffu
+
+/* distinct strings of one column (log_dict.c) */
+typedef struct LogDict
+{
+    char* arena;                /* NUL-terminated strings back to back */
+    size_t arena_len, arena_cap;
+    uint32_t* offset;           /* arena offset of each code */
+    uint32_t* hash;             /* hash of each code */
+    uint32_t count, code_cap;
+    uint32_t* slots;            /* code + 1, 0 = empty */
+    uint32_t mask;
+} LogDict;
+
+/* columns that predicates and updates can name */
+typedef enum LogColumn
+{
+    LOG_COL_STATUS,
+    LOG_COL_SRC_IP,
+    LOG_COL_REFERENCE_TIME,
+    LOG_COL_URL,                /* dictionary code */
+    LOG_COL_BRO,                /* dictionary code */
+    LOG_COL_NONE = -1           /* no column: an ungrouped query */
+} LogColumn;
+
+typedef enum LogOp
+{
+    LOG_EQ, LOG_NE, LOG_LT, LOG_LE, LOG_GT, LOG_GE
+} LogOp;
+
+/* most columns one log_update_where call can set */
+#define LOG_MAX_SETS 8
+
+/* col op value; value is truncated to int for the 32-bit columns */
+typedef struct LogPred
+{
+    LogColumn col;
+    LogOp op;
+    long value;
+} LogPred;
+
+typedef struct LogSet
+{
+    LogColumn col;
+    long value;
+} LogSet;
+
+typedef struct LogStore
+{
+    size_t rows, capacity;      /* capacity is a multiple of 64 */
+    /* hot columns */
+    int* status;
+    int* src_ip;
+    long* reference_time;
+    /* dictionary codes of the string fields */
+    uint32_t* URL;
+    uint32_t* bro;
+    LogDict urls, bros;
+    /* bit (row % 64) of active[row / 64] is set when status[row] != 0 */
+    uint64_t* active;
+    size_t active_rows;
+    /* reference_time bounds of each 64-row block (log_zone.c); zone_upto is their running max, a sorted sparse index */
+    long* zone_min;
+    long* zone_max;
+    long* zone_upto;
+    /* bit (block % 64) of dirty[block / 64] is set when a row of that 64-row block was written since the epoch began */
+    uint64_t* dirty;
+    uint64_t epoch;
+    /* the update every clean block is up to date with (log_update.c), the only one log_update_dirty
+       runs on the dirty blocks alone; dirty_current while every row is, so the key survives the next epoch */
+    int dirty_keyed, dirty_current;
+    LogPred dirty_pred;
+    LogSet dirty_sets[LOG_MAX_SETS];
+    int dirty_nsets;
+    /* src_ip -> rows (log_index.c), NULL until built */
+    struct LogIpIndex* ip_index;
+    /* threads for scans and updates, 0 for all available */
+    int threads;
+    /* file mapping the arrays point into (log_file.c), NULL when they are on the heap */
+    void* map;
+    size_t map_bytes;
+} LogStore;
+
+/* partition granularity of parallel scans: one bitmap word, whole lines in every column */
+#define LOG_SCAN_ROWS 64
+
+/* processes rows [begin, end) on worker tid */
+typedef void (*LogScanFn)(LogStore* s, size_t begin, size_t end, int tid, void* ctx);
+
+/* the 32-bit columns; code columns compare as int, codes stay far below 2^31 */
+static inline int* log_int_column(const LogStore* s, LogColumn col)
+{
+    switch (col)
+    {
+    case LOG_COL_STATUS: return s->status;
+    case LOG_COL_URL: return (int*)s->URL;
+    case LOG_COL_BRO: return (int*)s->bro;
+    default: return s->src_ip;
+    }
+}
+
+void log_store_init(LogStore* s, size_t capacity);
+void log_store_free(LogStore* s);
+size_t log_store_append(LogStore* s, const LogRecord* r);
+/* append without a LogRecord; strings are not NUL-terminated and longer ones are cut to LOG_STR_MAX */
+size_t log_store_append_fields(LogStore* s, int src_ip, const char* URL, size_t url_len,
+                               long reference_time, const char* bro, size_t bro_len, int status);
+void log_store_get(const LogStore* s, size_t row, LogRecord* r);
+void log_store_set_status(LogStore* s, size_t row, int status);
+
+/* first active row at or after row, or s->rows when there is none */
+size_t log_active_next(const LogStore* s, size_t row);
+/* writes the active rows in [begin, end) to out, returns how many */
+size_t log_active_rows(const LogStore* s, size_t begin, size_t end, uint32_t* out);
+
+void log_make_logs(LogStore* s, size_t n);
+/* n rows of synthetic web traffic: skewed URLs, a few browsers, nearly sorted times */
+void log_make_traffic(LogStore* s, size_t n, unsigned int seed);
+/* for the test programs: prints "check failed: what" and exits with -1 unless ok */
+void log_check(int ok, const char* what);
+/* CLOCK_MONOTONIC in seconds */
+double log_now(void);
+/* bytes held by the columns, bitmap and dictionaries */
+size_t log_store_bytes(const LogStore* s);
+/* counts[code] = rows whose col (LOG_COL_URL or LOG_COL_BRO) has that code */
+void log_count_codes(const LogStore* s, LogColumn col, size_t* counts);
+
+/* appends, log_store_set_status and updates mark the blocks they write; direct column writes call log_mark_dirty */
+void log_mark_dirty(LogStore* s, size_t begin, size_t end);
+size_t log_dirty_blocks(const LogStore* s);
+/* clears the dirty blocks and returns the new epoch; run the dirty update first, with no write after it */
+uint64_t log_epoch_advance(LogStore* s);
+
+/* log_file.c: save a table, map one back (0 on success, -1 after printing why) */
+int log_store_save(const LogStore* s, const char* path);
+int log_store_map(LogStore* s, const char* path);
+/* moves a mapped store to the heap so it can grow; append does this itself */
+void log_store_unmap(LogStore* s);
+
+/* log_parse.c: combined-format access logs */
+typedef struct LogIngestStats
+{
+    size_t rows, bad, bytes;    /* lines appended, lines skipped, input size */
+    double parse_s, append_s;   /* parallel parse, then in-order append */
+} LogIngestStats;
+
+/* parses buf[0, len) on threads threads (0 = all) and appends the rows in input order; st may be NULL */
+size_t log_ingest_buffer(LogStore* s, const char* buf, size_t len, int threads, LogIngestStats* st);
+size_t log_ingest_file(LogStore* s, const char* path, int threads, LogIngestStats* st);
+
+/* log_ring.c: bounded multi-producer, single-consumer append ring */
+typedef struct LogEvent
+{
+    int src_ip, status;
+    long reference_time;
+    uint16_t url_len, bro_len;
+    char URL[LOG_STR_LEN];
+    char bro[LOG_STR_LEN];
+} LogEvent;
+
+typedef struct LogRingSlot
+{
+    _Alignas(LOG_ALIGN) atomic_size_t seq;  /* pos while free for the producer of pos, pos + 1 once published */
+    LogEvent ev;
+} LogRingSlot;
+
+typedef struct LogRing
+{
+    LogRingSlot* slots;
+    size_t mask;
+    _Alignas(LOG_ALIGN) atomic_size_t head;  /* next position to claim, shared by producers */
+    _Alignas(LOG_ALIGN) size_t tail;         /* next position to drain, consumer only */
+} LogRing;
+
+/* capacity is rounded up to a power of two */
+void log_ring_init(LogRing* r, size_t capacity);
+void log_ring_free(LogRing* r);
+/* any thread; waits while the ring is full. Strings longer than LOG_STR_MAX are cut */
+void log_ring_push(LogRing* r, int src_ip, const char* URL, size_t url_len, long reference_time,
+                   const char* bro, size_t bro_len, int status);
+/* the consumer thread: appends up to max published events in claim order, returns how many */
+size_t log_ring_drain(LogRing* r, LogStore* s, size_t max);
+
+/* log_zone.c: zone maps of reference_time, kept by append and update */
+/* recomputes the zones; needed only after writing reference_time directly */
+void log_zone_rebuild(LogStore* s);
+/* includes t in the zone of block; zone_upto needs log_zone_fix_upto afterwards */
+void log_zone_widen(LogStore* s, size_t block, long t);
+void log_zone_fix_upto(LogStore* s, size_t block);
+/* first block whose zone_upto reaches lo: no earlier block holds a time >= lo */
+size_t log_zone_first(const LogStore* s, long lo);
+/* rows with lo <= reference_time < hi in row order into out (NULL to count); visited counts the blocks read */
+size_t log_time_range(const LogStore* s, long lo, long hi, uint32_t* out, size_t* visited);
+
+/* log_index.c: hash index from src_ip to rows, kept by append; updates that write src_ip drop it */
+void log_ip_index_build(LogStore* s);
+void log_ip_index_drop(LogStore* s);
+void log_ip_index_add(LogStore* s, int src_ip, size_t row);
+size_t log_ip_index_bytes(const LogStore* s);
+/* rows of src_ip in ascending order; returns how many there are and writes at most max */
+size_t log_ip_lookup(const LogStore* s, int src_ip, uint32_t* out, size_t max);
+/* the rows of each ips[k] in turn, counts[k] of them; returns the total and writes at most max */
+size_t log_ip_lookup_many(const LogStore* s, const int* ips, size_t n, uint32_t* out, size_t max, size_t* counts);
+
+/* log_pack.c: block-compressed reference_time */
+#define LOG_PACK_ROWS 128
+
+typedef struct LogPackBlock
+{
+    long min, max;
+    uint32_t offset;            /* first word of the block in data */
+    uint32_t start, step;       /* delta blocks: first offset and smallest delta, mod 2^32 */
+    uint8_t bits, mode;
+} LogPackBlock;
+
+typedef struct LogTimePack
+{
+    size_t rows, blocks, words;
+    LogPackBlock* block;
+    uint32_t* data;
+} LogTimePack;
+
+void log_time_pack(LogTimePack* p, const long* values, size_t rows);
+void log_time_pack_free(LogTimePack* p);
+size_t log_time_pack_bytes(const LogTimePack* p);
+/* the LOG_PACK_ROWS values of a block, padding included */
+void log_time_unpack(const LogTimePack* p, size_t block, long* out);
+/* rows where value op holds; mask (2 words per block) may be NULL, decoded counts blocks that had to be unpacked */
+size_t log_time_select(const LogTimePack* p, LogOp op, long value, uint64_t* mask, int threads, size_t* decoded);
+
+/* log_sketch.c: fixed-size summaries of the URL and src_ip columns, mergeable across threads */
+#define LOG_CM_DEPTH 4
+#define LOG_CM_BITS 13              /* 2^13 counters per Count-Min row */
+#define LOG_TOPK 32
+#define LOG_HLL_BITS 14             /* 2^14 HyperLogLog registers, about 0.8% error */
+
+typedef struct LogHeavy
+{
+    uint32_t hash;                  /* log_str_hash of URL */
+    uint32_t count;                 /* Count-Min estimate, never below the true count */
+    char URL[LOG_STR_LEN];
+} LogHeavy;
+
+typedef struct LogSketch
+{
+    uint64_t rows;
+    uint32_t* cm;                   /* LOG_CM_DEPTH rows of 2^LOG_CM_BITS counters */
+    uint8_t* hll;                   /* 2^LOG_HLL_BITS registers */
+    int ntop;
+    uint32_t top_hash[LOG_TOPK];    /* hash of each heap entry, searched with SIMD */
+    LogHeavy top[LOG_TOPK];         /* min-heap on count */
+} LogSketch;
+
+void log_sketch_init(LogSketch* k);
+void log_sketch_free(LogSketch* k);
+size_t log_sketch_bytes(const LogSketch* k);
+/* one event from the stream; the URL is not NUL-terminated */
+void log_sketch_add(LogSketch* k, const char* URL, size_t url_len, int src_ip);
+/* adds every row of s on s->threads threads */
+void log_sketch_scan(LogSketch* k, LogStore* s);
+/* k becomes the sketch of both streams */
+void log_sketch_merge(LogSketch* k, const LogSketch* other);
+/* estimated rows of URL */
+uint32_t log_sketch_count(const LogSketch* k, const char* URL);
+/* estimated distinct src_ip */
+double log_sketch_distinct(const LogSketch* k);
+/* the heavy hitters by estimated count, most frequent first; returns how many */
+int log_sketch_top(const LogSketch* k, LogHeavy* out);
+int log_sketch_save(const LogSketch* k, const char* path);
+int log_sketch_load(LogSketch* k, const char* path);
+
+/* log_search.c: substring search over the URL column */
+/* match[code] = 1 when string code of d contains pattern, else 0; returns the codes that match. threads 0 = all */
+size_t log_dict_search(const LogDict* d, const char* pattern, uint8_t* match, int threads);
+/* rows whose URL code c has match[c] set, on s->threads threads; mask (one bit per row) may be NULL */
+size_t log_url_match(LogStore* s, const uint8_t* match, uint64_t* mask);
+/* rows whose URL contains pattern: log_dict_search on the URL dictionary, then log_url_match */
+size_t log_url_search(LogStore* s, const char* pattern, uint64_t* mask);
+
+/* log_dict.c */
+/* the hash the dictionaries keep for each string (FNV-1a) */
+uint32_t log_str_hash(const char* str, size_t len);
+void log_dict_init(LogDict* d);
+void log_dict_free(LogDict* d);
+uint32_t log_dict_intern(LogDict* d, const char* str);
+uint32_t log_dict_intern_n(LogDict* d, const char* str, size_t len);
+uint32_t log_dict_find(const LogDict* d, const char* str);
+const char* log_dict_str(const LogDict* d, uint32_t code);
+
+/* log_scan.c */
+int log_max_threads(void);
+void log_scan_parallel(LogStore* s, LogScanFn fn, void* ctx, int threads);
+
+/* log_update.c */
+int log_pred_eval(const LogStore* s, LogPred p, size_t row);
+/* bit k set when pred holds for row base + k; base is a multiple of 64, rows past s->rows are not masked */
+uint64_t log_pred_mask(const LogStore* s, LogPred p, size_t base);
+/* where pred holds, set every sets[k].col to sets[k].value; returns the rows matched */
+size_t log_update_where(LogStore* s, LogPred pred, const LogSet* sets, int nsets);
+/*
+ * the same on the dirty blocks only: an update repeated over unchanged rows changes nothing.
+ * Meant for one fixed update re-run every epoch: any other update, or one the last epoch
+ * ended without, runs over every block and becomes the update the dirty blocks are kept for.
+ */
+size_t log_update_dirty(LogStore* s, LogPred pred, const LogSet* sets, int nsets);
+void log_traverse(LogStore* s);
+/* traverse of the rows written since the last epoch, then a new epoch */
+void log_traverse_dirty(LogStore* s);
+
+/* log_query.c: filter -> project -> group by -> aggregate */
+#define LOG_MAX_PREDS 4
+
+typedef struct LogQuery
+{
+    LogPred where[LOG_MAX_PREDS];   /* rows where all of them hold */
+    int npreds;
+    LogColumn group;                /* LOG_COL_NONE for a single group */
+    LogColumn value;                /* aggregated into sum, min and max */
+} LogQuery;
+
+typedef struct LogGroup
+{
+    long key;
+    size_t count;
+    long sum, min, max;
+} LogGroup;
+
+typedef struct LogGroups
+{
+    LogGroup* groups;               /* in no particular order until log_groups_sort */
+    size_t count;
+} LogGroups;
+
+/* runs q in one pass over s on s->threads threads; returns the rows matched */
+size_t log_query(LogStore* s, const LogQuery* q, LogGroups* out);
+void log_groups_free(LogGroups* g);
+/* ascending by key */
+void log_groups_sort(LogGroups* g);
+/* the group with this key, or NULL; the groups must be sorted */
+const LogGroup* log_groups_find(const LogGroups* g, long key);
+
+#endif
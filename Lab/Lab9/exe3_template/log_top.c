@@ -0,0 +1,132 @@
+/**
+ * Heavy-hitter URLs and distinct src_ip of a table of synthetic traffic
+ * through the streaming sketches. Checks that the sketch of the table is the
+ * same on 1 and 4 threads and when the rows are streamed in two halves and
+ * merged, that no estimate is below the exact count and the exact top 10 are
+ * all reported, that the distinct count is close, and that a saved sketch
+ * loads back unchanged. Then times the sketch against exact hash aggregation
+ * and compares their memory.
+ *
+ * Usage: ./log_top [rows]
+ */
+#include "log_store.h"
+#include <math.h>
+
+static int same_sketch(const LogSketch* a, const LogSketch* b)
+{
+    return a->rows == b->rows
+           && memcmp(a->cm, b->cm, (size_t)LOG_CM_DEPTH * (1u << LOG_CM_BITS) * sizeof(uint32_t)) == 0
+           && memcmp(a->hll, b->hll, 1u << LOG_HLL_BITS) == 0;
+}
+
+/* every estimate covers the exact count and the exact top 10 are there; returns the largest overcount */
+static uint32_t check_top(const LogStore* s, const LogSketch* k, const size_t* counts, const char* what)
+{
+    LogHeavy top[LOG_TOPK];
+    uint32_t over = 0, code;
+    int n = log_sketch_top(k, top), i, j;
+    for (i = 0; i < n; i++)
+    {
+        code = log_dict_find(&s->urls, top[i].URL);
+        log_check(code != LOG_NO_CODE && top[i].count >= counts[code], what);
+        log_check(log_sketch_count(k, top[i].URL) == top[i].count, what);
+        log_check(i == 0 || top[i - 1].count >= top[i].count, what);
+        over = top[i].count - counts[code] > over ? top[i].count - counts[code] : over;
+    }
+
+    char* taken = calloc(s->urls.count, 1);
+    for (j = 0; j < 10 && j < (int)s->urls.count; j++)
+    {
+        uint32_t best = UINT32_MAX;
+        for (code = 0; code < s->urls.count; code++)
+            if (!taken[code] && (best == UINT32_MAX || counts[code] > counts[best])) best = code;
+        taken[best] = 1;
+        const char* url = log_dict_str(&s->urls, best);
+        for (i = 0; i < n && strcmp(top[i].URL, url) != 0; i++)
+            ;
+        /* with a full heap, ties at the bottom may be left out */
+        log_check(i < n || (n == LOG_TOPK && counts[best] <= top[n - 1].count), what);
+    }
+    free(taken);
+    return over;
+}
+
+int main(int argc, char** argv)
+{
+    size_t rows = argc > 1 ? (size_t)atol(argv[1]) : NUM_ENTRIES, i;
+    LogStore s;
+    LogSketch one, four, half, rest, loaded;
+    LogGroups ips, urls;
+    LogQuery by_ip = {{{0}}, 0, LOG_COL_SRC_IP, LOG_COL_NONE};
+    LogQuery by_url = {{{0}}, 0, LOG_COL_URL, LOG_COL_NONE};
+    if (rows < 1)
+    {
+        rows = 1;
+    }
+    log_store_init(&s, rows);
+    log_make_traffic(&s, rows, 1);
+    size_t* counts = malloc(s.urls.count * sizeof(size_t));
+    log_count_codes(&s, LOG_COL_URL, counts);
+
+    /* the same sketch whichever way the rows go in */
+    log_sketch_init(&one);
+    log_sketch_init(&four);
+    s.threads = 1;
+    double t0 = log_now();
+    log_sketch_scan(&one, &s);
+    double t1 = log_now();
+    s.threads = 4;
+    log_sketch_scan(&four, &s);
+    double t2 = log_now();
+    log_check(same_sketch(&one, &four), "1 and 4 threads");
+
+    log_sketch_init(&half);
+    log_sketch_init(&rest);
+    for (i = 0; i < rows; i++)
+    {
+        const char* url = log_dict_str(&s.urls, s.URL[i]);
+        log_sketch_add(i < rows / 2 ? &half : &rest, url, strlen(url), s.src_ip[i]);
+    }
+    log_sketch_merge(&half, &rest);
+    log_check(same_sketch(&one, &half), "streamed halves merged");
+
+    uint32_t over = check_top(&s, &one, counts, "heavy hitters, 1 thread");
+    check_top(&s, &four, counts, "heavy hitters, 4 threads");
+    check_top(&s, &half, counts, "heavy hitters, merged halves");
+
+    s.threads = 0;
+    double t3 = log_now();
+    log_query(&s, &by_ip, &ips);
+    log_query(&s, &by_url, &urls);
+    double t4 = log_now();
+    double distinct = log_sketch_distinct(&one);
+    log_check(fabs(distinct - ips.count) <= 0.03 * ips.count + 1, "distinct src_ip");
+
+    log_check(log_sketch_save(&one, "sketch.bin") == 0, "save sketch");
+    log_check(log_sketch_load(&loaded, "sketch.bin") == 0, "load sketch");
+    log_check(same_sketch(&one, &loaded) && loaded.ntop == one.ntop
+              && memcmp(loaded.top, one.top, one.ntop * sizeof(LogHeavy)) == 0, "sketch round trip");
+
+    LogHeavy top[LOG_TOPK];
+    int n = log_sketch_top(&one, top), j;
+    printf("top URLs of %zu rows (estimate / exact):\n", rows);
+    for (j = 0; j < n && j < 5; j++)
+        printf("  %-40s %u / %zu\n", top[j].URL, top[j].count, counts[log_dict_find(&s.urls, top[j].URL)]);
+    printf("largest overcount in the top %d: %u (bound e*N/width = %.0f)\n", n, over,
+           exp(1.0) * rows / (1u << LOG_CM_BITS));
+    printf("distinct src_ip: %.0f estimated, %zu exact (%+.2f%%)\n", distinct, ips.count,
+           100 * (distinct - ips.count) / (ips.count ? ips.count : 1));
+    printf("sketch %f s on 1 thread, %f s on 4, %zu bytes; exact group by src_ip and URL %f s, %zu bytes of groups\n",
+           t1 - t0, t2 - t1, log_sketch_bytes(&one), t4 - t3, (ips.count + urls.count) * sizeof(LogGroup));
+
+    log_groups_free(&ips);
+    log_groups_free(&urls);
+    log_sketch_free(&one);
+    log_sketch_free(&four);
+    log_sketch_free(&half);
+    log_sketch_free(&rest);
+    log_sketch_free(&loaded);
+    free(counts);
+    log_store_free(&s);
+    return 0;
+}
@@ -0,0 +1,348 @@
+/**
+ * Bulk "where predicate, set columns" updates on the log store.
+ * Rows are handled 64 at a time. AVX2 compares of the predicate column give a
+ * 64-bit row mask (status != 0 is read straight from the active bitmap),
+ * blocks with no match are skipped without touching the target columns, and
+ * matches are written with masked stores. Words with only a few matches are
+ * written row by row instead, which is cheaper than 8 or 16 masked stores.
+ * Updates run on the partitioned scan executor, one 64-row aligned range per
+ * thread, so no two threads ever write the same bitmap word or column line.
+ * Writing reference_time widens the zone maps of the blocks it touches.
+ *
+ * Updates mark the blocks they write in the dirty bitmap. An update only
+ * ever sets the matching rows to constants, so running it again over rows
+ * nobody wrote since changes nothing: log_update_dirty runs it on the dirty
+ * blocks alone, skipping 64 clean blocks per bitmap word, and the 100
+ * traverse passes of log_base.c cost one pass plus 99 bitmap sweeps. That
+ * holds for one update only, the one the store is keyed to: the clean blocks
+ * say nothing about another predicate or other values, and an epoch that
+ * began with rows the update never saw leaves them clean. log_update_dirty
+ * for any other update, or after such an epoch, runs over every block and
+ * keys the store to the update it ran.
+ */
+#include "log_store.h"
+#include <immintrin.h>
+
+/* at most this many matches in a 64-row block are written one by one */
+#define LOG_SPARSE_BITS 4
+
+static inline __m256i cmp32(__m256i x, __m256i v, LogOp op)
+{
+    switch (op)
+    {
+    case LOG_EQ: return _mm256_cmpeq_epi32(x, v);
+    case LOG_NE: return _mm256_xor_si256(_mm256_cmpeq_epi32(x, v), _mm256_set1_epi32(-1));
+    case LOG_LT: return _mm256_cmpgt_epi32(v, x);
+    case LOG_LE: return _mm256_xor_si256(_mm256_cmpgt_epi32(x, v), _mm256_set1_epi32(-1));
+    case LOG_GT: return _mm256_cmpgt_epi32(x, v);
+    default:     return _mm256_xor_si256(_mm256_cmpgt_epi32(v, x), _mm256_set1_epi32(-1));
+    }
+}
+
+static inline __m256i cmp64(__m256i x, __m256i v, LogOp op)
+{
+    switch (op)
+    {
+    case LOG_EQ: return _mm256_cmpeq_epi64(x, v);
+    case LOG_NE: return _mm256_xor_si256(_mm256_cmpeq_epi64(x, v), _mm256_set1_epi64x(-1));
+    case LOG_LT: return _mm256_cmpgt_epi64(v, x);
+    case LOG_LE: return _mm256_xor_si256(_mm256_cmpgt_epi64(x, v), _mm256_set1_epi64x(-1));
+    case LOG_GT: return _mm256_cmpgt_epi64(x, v);
+    default:     return _mm256_xor_si256(_mm256_cmpgt_epi64(v, x), _mm256_set1_epi64x(-1));
+    }
+}
+
+int log_pred_eval(const LogStore* s, LogPred p, size_t row)
+{
+    long x = p.col == LOG_COL_REFERENCE_TIME ? s->reference_time[row] : log_int_column(s, p.col)[row];
+    long v = p.col == LOG_COL_REFERENCE_TIME ? p.value : (int)p.value;
+    switch (p.op)
+    {
+    case LOG_EQ: return x == v;
+    case LOG_NE: return x != v;
+    case LOG_LT: return x < v;
+    case LOG_LE: return x <= v;
+    case LOG_GT: return x > v;
+    default:     return x >= v;
+    }
+}
+
+/* predicate mask of the 64 rows starting at base */
+static inline uint64_t block_mask(const LogStore* s, LogPred p, size_t base)
+{
+    uint64_t m = 0;
+    int k;
+    if (p.col == LOG_COL_REFERENCE_TIME)
+    {
+        const long* c = s->reference_time + base;
+        __m256i v = _mm256_set1_epi64x(p.value);
+        for (k = 0; k < 64; k += 4)
+        {
+            __m256i x = _mm256_load_si256((const __m256i*)(c + k));
+            m |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(cmp64(x, v, p.op))) << k;
+        }
+    }
+    else
+    {
+        const int* c = log_int_column(s, p.col) + base;
+        __m256i v = _mm256_set1_epi32((int)p.value);
+        for (k = 0; k < 64; k += 8)
+        {
+            __m256i x = _mm256_load_si256((const __m256i*)(c + k));
+            m |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(cmp32(x, v, p.op))) << k;
+        }
+    }
+    return m;
+}
+
+uint64_t log_pred_mask(const LogStore* s, LogPred p, size_t base)
+{
+    if (p.col == LOG_COL_STATUS && p.op == LOG_NE && p.value == 0)
+    {
+        return s->active[base / 64];
+    }
+    return block_mask(s, p, base);
+}
+
+/* an update target with its column and value resolved once per call */
+typedef struct Target
+{
+    int* i32;
+    long* i64;
+    int v32;
+    long v64;
+} Target;
+
+/* writes the target value to the rows of m in the 64-row block at base */
+static inline void block_set(const Target* t, size_t base, uint64_t m)
+{
+    int k;
+    if (m == ~0ULL)
+    {
+        /* a fully matching block needs no masks */
+        if (t->i64)
+            for (k = 0; k < 64; k++) t->i64[base + k] = t->v64;
+        else
+            for (k = 0; k < 64; k++) t->i32[base + k] = t->v32;
+    }
+    else if (t->i64)
+    {
+        const __m256i lane = _mm256_setr_epi64x(1, 2, 4, 8);
+        __m256i v = _mm256_set1_epi64x(t->v64);
+        for (k = 0; k < 64; k += 4)
+        {
+            unsigned int bits = (m >> k) & 0xf;
+            if (!bits) continue;
+            __m256i mask = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(bits), lane), lane);
+            _mm256_maskstore_epi64((long long*)(t->i64 + base + k), mask, v);
+        }
+    }
+    else
+    {
+        const __m256i lane = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        __m256i v = _mm256_set1_epi32(t->v32);
+        for (k = 0; k < 64; k += 8)
+        {
+            unsigned int bits = (m >> k) & 0xff;
+            if (!bits) continue;
+            __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits), lane), lane);
+            _mm256_maskstore_epi32(t->i32 + base + k, mask, v);
+        }
+    }
+}
+
+/* keeps the active bitmap in step when an update writes status; returns the change in active rows */
+static inline long block_status(LogStore* s, long value, size_t base, uint64_t m)
+{
+    uint64_t* w = &s->active[base / 64];
+    uint64_t next = value ? *w | m : *w & ~m;
+    long delta = __builtin_popcountll(next) - __builtin_popcountll(*w);
+    *w = next;
+    return delta;
+}
+
+typedef struct Update
+{
+    LogPred pred;
+    const LogSet* sets;
+    int nsets;
+    int dirty_only;             /* visit only the dirty blocks */
+    size_t matched;
+} Update;
+
+/* ranges share dirty words, so a worker collects the bits of one word before setting them */
+static inline void flush_dirty(LogStore* s, size_t word, uint64_t bits)
+{
+    if (bits)
+    {
+        __atomic_fetch_or(&s->dirty[word], bits, __ATOMIC_RELAXED);
+    }
+}
+
+static void update_range(LogStore* s, size_t begin, size_t end, int tid, void* ctx)
+{
+    Update* u = ctx;
+    LogPred pred = u->pred;
+    const LogSet* sets = u->sets;
+    size_t base, n = end, matched = 0, word = begin / 4096;
+    uint64_t written = 0;
+    long active_delta = 0;
+    int j, nsets = u->nsets, status_set = -1, time_set = -1;
+    int bitmap = pred.col == LOG_COL_STATUS && pred.op == LOG_NE && pred.value == 0;
+    Target t[LOG_MAX_SETS];
+    (void)tid;
+
+    for (j = 0; j < nsets; j++)
+    {
+        t[j].i64 = sets[j].col == LOG_COL_REFERENCE_TIME ? s->reference_time : NULL;
+        t[j].i32 = t[j].i64 ? NULL : log_int_column(s, sets[j].col);
+        t[j].v64 = sets[j].value;
+        t[j].v32 = (int)sets[j].value;
+        if (sets[j].col == LOG_COL_STATUS)
+            status_set = j;
+        if (sets[j].col == LOG_COL_REFERENCE_TIME)
+            time_set = j;
+    }
+
+    /* capacity is a multiple of 64, so the last block can be loaded whole and masked */
+    for (base = begin; base < n; base += 64)
+    {
+        if (u->dirty_only)
+        {
+            uint64_t d = s->dirty[base / 4096] >> (base / 64 % 64);
+            if (!d)
+            {
+                /* the rest of this dirty word is clean */
+                base = (base / 4096 + 1) * 4096 - 64;
+                continue;
+            }
+            if (!(d & 1))
+                continue;
+        }
+        uint64_t m = bitmap ? s->active[base / 64] : block_mask(s, pred, base);
+        if (n - base < 64)
+        {
+            m &= ~0ULL >> (64 - (n - base));
+        }
+        if (!m) continue;
+        int hits = __builtin_popcountll(m);
+        matched += hits;
+        if (hits <= LOG_SPARSE_BITS)
+        {
+            for (j = 0; j < nsets; j++)
+            {
+                uint64_t r;
+                if (t[j].i64)
+                    for (r = m; r; r &= r - 1) t[j].i64[base + __builtin_ctzll(r)] = t[j].v64;
+                else
+                    for (r = m; r; r &= r - 1) t[j].i32[base + __builtin_ctzll(r)] = t[j].v32;
+            }
+        }
+        else
+        {
+            for (j = 0; j < nsets; j++)
+                block_set(&t[j], base, m);
+        }
+        if (status_set >= 0)
+            active_delta += block_status(s, sets[status_set].value, base, m);
+        if (time_set >= 0)
+            log_zone_widen(s, base / 64, sets[time_set].value);
+        if (!u->dirty_only)
+        {
+            if (base / 4096 != word)
+            {
+                flush_dirty(s, word, written);
+                word = base / 4096;
+                written = 0;
+            }
+            written |= 1ULL << (base / 64 % 64);
+        }
+    }
+    flush_dirty(s, word, written);
+#pragma omp atomic
+    u->matched += matched;
+    if (active_delta)
+    {
+#pragma omp atomic
+        s->active_rows += active_delta;
+    }
+}
+
+/* the update the store's dirty bitmap is kept for */
+static int keyed_to(const LogStore* s, LogPred pred, const LogSet* sets, int nsets)
+{
+    int j;
+    if (!s->dirty_keyed || s->dirty_nsets != nsets || s->dirty_pred.col != pred.col || s->dirty_pred.op != pred.op
+        || s->dirty_pred.value != pred.value)
+    {
+        return 0;
+    }
+    for (j = 0; j < nsets; j++)
+    {
+        if (s->dirty_sets[j].col != sets[j].col || s->dirty_sets[j].value != sets[j].value)
+            return 0;
+    }
+    return 1;
+}
+
+static size_t run_update(LogStore* s, LogPred pred, const LogSet* sets, int nsets, int dirty_only)
+{
+    Update u = {pred, sets, nsets, 0, 0};
+    int j, keyed;
+    if (nsets > LOG_MAX_SETS)
+    {
+        printf("log_update_where: at most %d columns per update\n", LOG_MAX_SETS);
+        exit(-1);
+    }
+    keyed = keyed_to(s, pred, sets, nsets);
+    u.dirty_only = dirty_only && keyed;
+    log_scan_parallel(s, update_range, &u, s->threads);
+    if (keyed || dirty_only)
+    {
+        /* every row now holds this update's result */
+        s->dirty_keyed = 1;
+        s->dirty_current = 1;
+        s->dirty_pred = pred;
+        memcpy(s->dirty_sets, sets, nsets * sizeof(LogSet));
+        s->dirty_nsets = nsets;
+    }
+    else if (u.matched)
+    {
+        /* another update wrote rows, marked dirty; the next epoch would drop them */
+        s->dirty_current = 0;
+    }
+    for (j = 0; j < nsets && u.matched; j++)
+    {
+        if (sets[j].col == LOG_COL_REFERENCE_TIME)
+            log_zone_fix_upto(s, 0);
+        /* rows move between postings lists; rebuilding is cheaper than editing them */
+        if (sets[j].col == LOG_COL_SRC_IP)
+            log_ip_index_drop(s);
+    }
+    return u.matched;
+}
+
+size_t log_update_where(LogStore* s, LogPred pred, const LogSet* sets, int nsets)
+{
+    return run_update(s, pred, sets, nsets, 0);
+}
+
+size_t log_update_dirty(LogStore* s, LogPred pred, const LogSet* sets, int nsets)
+{
+    return run_update(s, pred, sets, nsets, 1);
+}
+
+/* traverse() is one masked update: where status != 0 set reference_time = 0, src_ip = 0 */
+static const LogPred traverse_pred = {LOG_COL_STATUS, LOG_NE, 0};
+static const LogSet traverse_sets[2] = {{LOG_COL_REFERENCE_TIME, 0}, {LOG_COL_SRC_IP, 0}};
+
+void log_traverse(LogStore* s)
+{
+    log_update_where(s, traverse_pred, traverse_sets, 2);
+}
+
+void log_traverse_dirty(LogStore* s)
+{
+    log_update_dirty(s, traverse_pred, traverse_sets, 2);
+    log_epoch_advance(s);
+}
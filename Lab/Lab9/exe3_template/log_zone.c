@@ -0,0 +1,92 @@
+/**
+ * Zone maps on reference_time.
+ * Every 64-row block keeps the smallest and largest time it holds, and
+ * zone_upto[b] is the largest time in blocks 0..b. zone_upto never decreases,
+ * so it is a sorted sparse index over a column that is only nearly sorted: a
+ * binary search finds the first block that can hold a time at or after the
+ * window start, and from there the per-block bounds skip every block that
+ * cannot overlap. Appends extend the last zone. Updates that write
+ * reference_time only widen the zones of the blocks they touch, which keeps
+ * them correct if looser; log_zone_rebuild makes them exact again.
+ */
+#include "log_store.h"
+
+void log_zone_widen(LogStore* s, size_t block, long t)
+{
+    if (t < s->zone_min[block]) s->zone_min[block] = t;
+    if (t > s->zone_max[block]) s->zone_max[block] = t;
+}
+
+void log_zone_fix_upto(LogStore* s, size_t block)
+{
+    size_t b, blocks = (s->rows + 63) / 64;
+    for (b = block; b < blocks; b++)
+    {
+        s->zone_upto[b] = b && s->zone_upto[b - 1] > s->zone_max[b] ? s->zone_upto[b - 1] : s->zone_max[b];
+    }
+}
+
+void log_zone_rebuild(LogStore* s)
+{
+    size_t b, i, blocks = (s->rows + 63) / 64;
+    for (b = 0; b < blocks; b++)
+    {
+        size_t end = (b + 1) * 64 < s->rows ? (b + 1) * 64 : s->rows;
+        long min = s->reference_time[b * 64], max = min;
+        for (i = b * 64 + 1; i < end; i++)
+        {
+            if (s->reference_time[i] < min) min = s->reference_time[i];
+            if (s->reference_time[i] > max) max = s->reference_time[i];
+        }
+        s->zone_min[b] = min;
+        s->zone_max[b] = max;
+        s->zone_upto[b] = b && s->zone_upto[b - 1] > max ? s->zone_upto[b - 1] : max;
+    }
+}
+
+size_t log_zone_first(const LogStore* s, long lo)
+{
+    size_t a = 0, b = (s->rows + 63) / 64;
+    while (a < b)
+    {
+        size_t mid = a + (b - a) / 2;
+        if (s->zone_upto[mid] < lo)
+            a = mid + 1;
+        else
+            b = mid;
+    }
+    return a;
+}
+
+size_t log_time_range(const LogStore* s, long lo, long hi, uint32_t* out, size_t* visited)
+{
+    LogPred ge = {LOG_COL_REFERENCE_TIME, LOG_GE, lo}, lt = {LOG_COL_REFERENCE_TIME, LOG_LT, hi};
+    size_t b, n = 0, read = 0, blocks = (s->rows + 63) / 64;
+    for (b = log_zone_first(s, lo); b < blocks && lo < hi; b++)
+    {
+        if (s->zone_max[b] < lo || s->zone_min[b] >= hi)
+        {
+            continue;
+        }
+        read++;
+        uint64_t m = log_pred_mask(s, ge, b * 64) & log_pred_mask(s, lt, b * 64);
+        if (s->rows - b * 64 < 64)
+        {
+            m &= ~0ULL >> (64 - (s->rows - b * 64));
+        }
+        if (!out)
+        {
+            n += __builtin_popcountll(m);
+            continue;
+        }
+        for (; m; m &= m - 1)
+        {
+            out[n++] = b * 64 + __builtin_ctzll(m);
+        }
+    }
+    if (visited)
+    {
+        *visited = read;
+    }
+    return n;
+}